@@ -1,61 +1,202 @@
 #pragma once
 #include <Adafruit_VS1053.h>
 #include <QuickPID.h>
+#include "autotune.h"
+#include "bufferhealth.h"
+#include "fixedpid.h"
+#include "impulse.h"
+#include "ogg.h"
+#include "projector.h"
+#include "readahead.h"
+#include "sci.h"
+#include "sdi.h"
+#include "sessionlog.h"
+#include "syncfilter.h"
+#include "telemetry.h"
+#include "tickjitter.h"
+#include "tracks.h"
 
-union oggPage {
-  struct {
-    char     magicStr[4];
-    uint8_t  version;
-    uint8_t  headerType;
-    int64_t  granulePos;
-    uint32_t bitstreamSN;
-    uint32_t crc;
-    uint8_t  nSegments;
-  };
-  unsigned char header[23];
+// The PID and the sync error filter in fixed point (-D FIXED_PID) or float.
+// PID_ONE is a sample of sync error as fed to the PID.
+#if defined(FIXED_PID)
+  typedef FixedPID     SyncPID;
+  typedef FixedTracker SyncTracker;
+  typedef int32_t      pidValue;
+  #define PID_ONE      (1L << FIXED_Q)
+#else
+  typedef QuickPID     SyncPID;
+  typedef Tracker      SyncTracker;
+  typedef float        pidValue;
+  #define PID_ONE      1
+#endif
+
+#define SPEED_WINDOW_N   10  // number of PID ticks used for estimating projector speed
+#define DECODER_LATENCY_US 2000  // release of the decoder to output, until measured [us]
+
+struct vorbisID {                               // from the identification header
+  uint8_t  channels;
+  uint32_t fs;                                  // sampling rate [Hz]
+  uint32_t bitrate;                             // nominal [bit/s], 0 if not given
+};
+
+struct trackIndex {                             // header of a track's sidecar file (.idx)
+  char     magic[4];                            // "SKIX"
+  uint32_t version;
+  uint32_t fileSize;                            // of the track ...
+  uint32_t modified;                            // ... and its time stamp (FAT format)
+  uint32_t fs;                                  // sampling rate [Hz]
+  uint32_t samples;                             // duration [samples]
+  uint32_t audioStart;                          // position of the first audio page
+  uint32_t stride;                              // samples per entry
+  uint32_t entries;                             // {position of page, granule position before}
 };
 
 class Audio : public Adafruit_VS1053_FilePlayer {
   public:
     Audio(void);
     uint8_t begin();
-    bool selectTrack();
+    bool selectTrack(bool tune = false);       // tune: auto-tune the PID gains while playing
     bool SDinserted();
     const char getRevision();
-    static void countISR();
     static void leaderISR();
     bool loadTrack(uint16_t);
+    bool indexTrack();
+    void setImpulseSource(ImpulseSource*);
+    void setStartFrame(uint32_t);
+    const BufferHealth& bufferHealth() const { return health; }
+    const AutoTune& autoTune() const { return _autoTune; }
+    const TickJitter& tickJitter() const { return _jitter; }
 
   private:
-    QuickPID myPID = QuickPID(&Input, &Output, &Setpoint);
-    float Setpoint = 0, Input, Output;
+#if defined(SDI_DMA)
+    SdiBus sdi;
+#endif
+    SciBus sci;
+    ReadAhead _readAhead;
+    volatile bool _feedLock = false;
+    uint16_t _audata = 0;                       // shadow of SCI_AUDATA
+    uint16_t _hdat1 = 0;                        // shadow of SCI_HDAT1
+    uint16_t _playMode = 0;                     // shadow of playMode (WRAM 0x1e09)
+    vorbisID _vorbis = {};                      // of the cued track
+    uint32_t sciBytesPerTick = 0;
+    uint32_t sciMicrosPerTick = 0;
+    BufferHealth health;
+    AutoTune _autoTune;
+    TickJitter _jitter;
+#if defined(SESSION_LOG)
+    SessionLog _log;
+    logHeader sessionHeader();
+    void logTick(uint32_t, uint32_t, uint32_t, int32_t, bool);
+#endif
+#if defined(TELEMETRY)
+    Telemetry _telemetry;
+    void sendSession();
+    void sendTick(uint32_t, uint32_t, int32_t, float, bool);
+#endif
+
+    SyncPID myPID = SyncPID(&Input, &Output, &Setpoint);
+    pidValue Setpoint = 0, Input, Output;       // sync error [PID_ONE], output [ppm2]
 
     uint16_t _fsPhysical = 0;
-    char _filename[13] = {0};
+    char _filename[17] = {0};                   // "001-23.976-L.ogg"
     bool _isLoop = false;
-    uint8_t _fps = 0;
+    frameRate _fps;
     uint16_t _trackNum = 0;
+    TrackDirectory _tracks;
+    volatile bool _cardRemoved = false;         // since the tracks were scanned
     int32_t _frameOffset = 0;
+    uint8_t _filter = FILTER_AVERAGE;
+    ImpulseSource *_impulseSource;
 
-    uint32_t lastSampleCounterHaltPos = 0;
+    // start of playback at an arbitrary frame (see planSeek)
+    uint32_t _startFrame = 0;
+    uint32_t _spliceAt = 0;                     // file position to continue at _spliceTo from
+    uint32_t _spliceTo = 0;
+    int32_t  _seekOffset = 0;                   // sample count minus position in file
+    uint32_t _seekSamples = 0;                  // sample count at _startFrame
+    trackIndex _index;
+    bool _indexed = false;
+
+    uint32_t totalImpCounter = 0;
+    uint32_t lastImpMicros = 0;                 // in the time base of the impulse source
+    uint32_t impPeriod = 0;                     // smoothed [us]
+    uint32_t impInterval = 0;                   // between the last two impulses [us]
+    uint32_t impulseBase = 0;                   // impulseBuffer.pushed() when counting started
+    uint32_t _startImpulse = 0;                 // value of totalImpCounter playback starts on
+    uint32_t _decoderLatency = DECODER_LATENCY_US;  // measured at the last start
+    uint32_t impulseOverruns = 0;
     int32_t  syncOffsetImps = 0;
     uint32_t sampleCountBaseLine = 0;
-    uint16_t impToSamplerateFactor;
-    uint16_t deltaToFramesDivider;
-    uint16_t impToAudioSecondsDivider;
+    uint32_t samplesPerImpNum;                  // samples per impulse: fs * den / (num * blades)
+    uint32_t samplesPerImpDen;
+    int32_t  ppmLimitMin = -187000;
+    int32_t  ppmLimitMax = 511999;
+
+    // measurement of a PID tick, taken by the tick timer's interrupt
+    struct tickSample {
+      uint32_t micros;                          // when the sample counter was read
+      uint32_t period;                          // since the previous sample [us], 0 if none
+      uint32_t samples;                         // heard, see getHeardSampleCount()
+      int16_t  audioFill;
+      uint32_t pushed;                          // impulseBuffer.pushed() by then
+    };
+    tickSample _tickSample = {};
+    volatile bool _tickSampled = false;         // not yet taken up by the PID
+    uint32_t impulsesCounted = 0;               // impulseBuffer.pushed() as far as counted
+    bool     _creeping = false;                 // paused, but released to catch up (see creep())
+    uint32_t _creepCheck = 0;                   // micros() of the last comparison
+
+    // filters of the sync error
+    MovingAverage _average;
+    SyncTracker _tracker;
+
+    // feed-forward estimation of projector speed
+    uint32_t speedWindowImps[SPEED_WINDOW_N];
+    uint32_t speedWindowMicros[SPEED_WINDOW_N];
+    uint8_t  speedWindowIdx = 0;
+    uint8_t  _rampTicks = 0;                    // following a run-down or run-up for so many more ticks
+
+    // playback from the read-ahead buffer (hides the Adafruit counterparts)
+    bool startPlayingFile(const char*);
+    void pausePlaying(bool);
+    void fillReadAhead();
+    bool planSeek();
+    void splice();
+    void feed();
+    static void feedISR();
+    static void tickISR();
+    static void sdiSent(uint8_t);
+    void sendBuffer();
 
     bool loadPatch();
     void enableResampler(bool);
-    void adjustSamplerate(int32_t long);
+    void holdDecoder(bool);
+    void setPlayMode(uint16_t, bool);
+    void adjustSamplerate(int32_t);
     void clearSampleCounter();
     void clearErrorCounter();
-    void restoreSampleCounter(uint32_t);
-    int32_t average(int32_t);
-    void speedControlPID();
-    uint8_t handlePause();
+    void countImpulses();
+    void startImpulseCounter();
+    int32_t impsToSamples(int32_t);
+    void startTicks();
+    void stopTicks();
+    void sampleTick();
+    void speedControlPID(const tickSample&);
+    void autoTuneStep(bool);
+    void saveTuning();
+    void sampleBufferHealth(int16_t);
+    void resetSpeedEstimate();
+    float speedFeedForward();
+    float impulseRate(bool);
+    float rampFeedForward(bool);
+    uint8_t handlePause(bool);
+    void creep();
     static bool connected();
     uint16_t selectTrackScreen();
+    uint32_t startFrameScreen();
+    bool cue();
     uint32_t getSampleCount();
+    uint32_t getHeardSampleCount(int16_t*);
     uint32_t getAudioMillis();
     void drawPlayingMenuConstants();
     void drawWaitForPlayingMenu();
@@ -69,9 +210,15 @@ class Audio : public Adafruit_VS1053_FilePlayer {
 
     // related to OGG Vorbis
     bool isOgg();
-    size_t findInFile(File*, const char*, uint8_t, size_t);
+    void scanTracks();
+    bool probeTrack(uint16_t);
     size_t firstAudioPage(File*);
-    int64_t granulePos(oggPage*);
+    bool readVorbisID(File*, vorbisID*);
+    void sidecarName(char*, const char*);
+    bool readIndex(File*);
+    bool writeIndex(File*);
+    bool indexLookup(int64_t, size_t*, int64_t*);
+    static uint32_t modifiedStamp(File*);
 
     // methods for reading/writing to VS1053B WRAM
     uint16_t sciReadWRAM16(uint16_t);
@@ -81,6 +228,7 @@ class Audio : public Adafruit_VS1053_FilePlayer {
     void sciWriteWRAM32(uint16_t, uint32_t);
 
     // see http://www.vsdsp-forum.com/phpbb/viewtopic.php?p=6679#p6679
+    int16_t StreamBufferSizeWords(void);
     int16_t StreamBufferFillWords(void);
     int16_t StreamBufferFreeWords(void);
     int16_t AudioBufferFillWords(void);
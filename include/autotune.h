@@ -0,0 +1,60 @@
+#pragma once
+#include <Arduino.h>
+
+#define AUTOTUNE_SETTLE_TICKS   30        // locked by the PID, noise of the sync error is measured
+#define AUTOTUNE_DISCARD         2        // relay cycles until the oscillation has settled
+#define AUTOTUNE_CYCLES          4        // relay cycles measured
+#define AUTOTUNE_TIMEOUT_TICKS 1800       // give up after this many PID ticks
+#define AUTOTUNE_RELAY_PPM2   2621        // relay amplitude: 0.5 % of playback speed
+#define AUTOTUNE_MIN_HYSTERESIS  2        // [samples]
+
+// Relay feedback experiment (Astrom & Hagglund) for the PID gains of a
+// projector. Once the PID has locked, it is replaced by a relay: playback
+// speed is switched between +/- a fixed amplitude around the feed-forward
+// whenever the sync error leaves a band around zero. The loop then oscillates
+// at its ultimate period Tu, and the amplitude of the sync error gives the
+// ultimate gain Ku - including everything between speed adjustment and
+// measured error: the VS1053B's response, the audio buffer, the sync error
+// filter and the PID tick. The band is set from the noise of the sync error
+// (i.e., of the projector's speed) before the relay is switched on. Gains
+// follow from Ku and Tu by the Ziegler-Nichols rules for a PI controller.
+// They are in the units of the PID (ppm2 per sample of sync error) and so
+// depend on the sampling rate: tune with a track at the rate you usually
+// play.
+class AutoTune {
+  public:
+    void begin(uint32_t tickMicros, float lockBand);  // lock: sync error within the band [samples]
+    float relay(float input, float pid);  // per PID tick: sync error [samples] and PID output -> output [ppm2]
+    void cancel();
+    bool running() const { return _phase == SETTLE || _phase == RELAY; }
+    bool done() const { return _phase == DONE; }
+    bool failed() const { return _phase == FAILED; }
+    float bias() const { return (_phase == DONE) ? _bias : 0; }   // mean output, for a bumpless handover
+    void print() const;                   // over serial
+
+    float ku = 0;                         // ultimate gain [ppm2 / sample]
+    float tu = 0;                         // ultimate period [s]
+    float hysteresis = 0;                 // [samples]
+    uint16_t p = 0, i = 0, d = 0;         // gains in hundredths, as stored in the projector's profile
+
+  private:
+    enum Phase : uint8_t { IDLE, SETTLE, RELAY, DONE, FAILED };
+    void finish();
+    static uint16_t gain(float);
+
+    Phase _phase = IDLE;
+    float _tick = 0;                      // [s]
+    float _lockBand = 0;                  // [samples]
+    uint16_t _ticks = 0;                  // since begin()
+    uint16_t _settled = 0;                // ticks within the lock band
+    float _previous = 0;                  // input of the previous tick
+    float _sum = 0, _sumSquares = 0;      // of input differences while settling
+    float _output = 0;
+    float _switched = 0;                  // last switch to -amplitude [ticks]
+    uint8_t _cycles = 0;                  // completed
+    float _max = 0, _min = 0;             // of the input in the current cycle
+    float _outputSum = 0;                 // of the current cycle
+    uint16_t _cycleTicks = 0;
+    float _periods = 0, _amplitudes = 0;  // sums over measured cycles
+    float _bias = 0;
+};
@@ -0,0 +1,40 @@
+#pragma once
+#include <Arduino.h>
+
+#define HEALTH_BINS 8    // bins of the fill level histograms
+
+// Statistics of the buffers between SD card and DAC, sampled once per PID
+// tick during playback: the read-ahead buffer in RAM, the VS1053B's stream
+// buffer (compressed data) and its audio buffer (decoded samples).
+// Underflows of the audio buffer are logged along with the fill levels at
+// the time, which tells starvation by the SD card (everything empty) from
+// starvation by the decoder (stream buffer still filled).
+class BufferHealth {
+  public:
+    struct Level {
+      uint8_t  now = 0;                   // [%]
+      uint8_t  lowest = 100;              // [%]
+      uint8_t  highest = 0;               // [%]
+      uint32_t histogram[HEALTH_BINS] = {0};  // ticks per 1/HEALTH_BINS of capacity
+      void clear();
+      void add(uint16_t fill, uint16_t capacity);
+    };
+
+    void clear();                         // start of session
+    void tick(uint16_t underflows);       // after adding levels for this tick
+    void print() const;                   // over serial
+    void show() const;                    // on the display, until button is pressed
+
+    Level readAhead, stream, audio;
+    uint32_t ticks = 0;
+    uint32_t underflows = 0;              // VS1053B underflow counter (0x5A82)
+    uint32_t underflowTicks = 0;          // ticks with at least one underflow
+
+    struct {                              // most recent underflow
+      uint32_t atMillis = 0;              // since start of session
+      uint8_t  readAhead = 0, stream = 0, audio = 0;  // fill levels [%]
+    } last;
+
+  private:
+    uint32_t _startMillis = 0;
+};
@@ -0,0 +1,40 @@
+#pragma once
+#include <Arduino.h>
+
+// CPU cycle counter for timing short stretches of code - differences of
+// cycles() are valid for up to 2^32 cycles. The Teensy 3.2 has the cycle
+// counter of the DWT. The Cortex-M0+ of the Teensy LC hasn't, so there the
+// cycles are counted by SysTick, which runs at F_CPU and reloads every ms.
+#if defined(SIMULATOR)                    // host: simulated time, see sim.h
+#include "sim.h"
+
+inline void cyclesBegin() {}
+
+inline uint32_t cycles() {
+  return sim::now * (F_CPU / 1000000);
+}
+#elif defined(__MKL26Z64__)
+extern "C" volatile uint32_t systick_millis_count;
+
+inline void cyclesBegin() {}
+
+inline uint32_t cycles() {
+  uint32_t ms, current;
+  do {                                    // SysTick may reload in between
+    ms      = systick_millis_count;
+    current = SYST_CVR;
+  } while (ms != systick_millis_count);
+  if ((SCB_ICSR & SCB_ICSR_PENDSTSET) && current > 50)
+    ms++;                                 // reloaded, but its interrupt is held off (as in micros())
+  return ms * (SYST_RVR + 1) + (SYST_RVR - current);
+}
+#else
+inline void cyclesBegin() {
+  ARM_DEMCR    |= ARM_DEMCR_TRCENA;
+  ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+}
+
+inline uint32_t cycles() {
+  return ARM_DWT_CYCCNT;
+}
+#endif
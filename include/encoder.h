@@ -0,0 +1,56 @@
+#pragma once
+#include <Arduino.h>
+#include <EventResponder.h>
+
+#define ENC_DEBOUNCE_US       5000    // button
+#define ENC_ACCEL_RATE          10    // [counts/s] slower turns count in single steps ...
+#define ENC_ACCEL_DIV          100    // ... faster ones in steps of 1 + (rate - ENC_ACCEL_RATE)^2 / ENC_ACCEL_DIV
+#define ENC_ACCEL_MAX          100    // largest step
+#define ENC_ACCEL_PAUSE_US  200000    // a turn starting after this long isn't accelerated yet
+
+// Rotary encoder with push button, decoded in pin change interrupts. Unlike a
+// polled encoder, it costs nothing while the knob is left alone. The encoder
+// is a half-step one (a detent at both 00 and 11 of the quadrature signals).
+// With acceleration on, quick turns count in larger steps, so that values far
+// away (e.g., track 999) can be reached with a flick. The callbacks are run
+// from yield(), not from the interrupt, so they may use the SPI bus.
+class RotaryEncoder {
+  public:
+    void begin(uint8_t pinA, uint8_t pinB, uint8_t pinButton);
+    int32_t getValue() const { return _value; }
+    void setValue(int32_t value);
+    void setLimits(int32_t min, int32_t max);
+    void setAcceleration(bool on) { _accelerate = on; }
+    bool valueChanged();                  // since the last call
+    bool getButton();                     // debounced, LOW while pressed
+    bool buttonChanged();                 // since the last call
+    void attachCallback(void (*callback)(int32_t value, int32_t delta)) { _callback = callback; }
+    void attachButtonCallback(void (*callback)(bool state)) { _buttonCallback = callback; }
+
+  private:
+    static void isrAB();
+    static void isrButton();
+    static void dispatch(EventResponderRef);
+    void count(int8_t direction);
+
+    uint8_t _pinA = 0, _pinB = 0, _pinButton = 0;
+    volatile int32_t _value = 0;
+    int32_t _min = INT32_MIN, _max = INT32_MAX;
+    volatile bool _changed = false;
+    volatile int32_t _delta = 0;          // since the last callback
+    volatile uint8_t _state = 0;          // of A and B
+    volatile int8_t _steps = 0;           // since the last detent
+    bool _accelerate = false;
+    int8_t _direction = 0;                // of the last count
+    uint32_t _lastCount = 0;              // [us]
+    uint32_t _interval = 0;               // between counts, smoothed [us]
+
+    volatile bool _button = HIGH;
+    volatile bool _buttonChanged = false;
+    volatile bool _buttonEvent = false;   // since the last callback
+    volatile uint32_t _buttonEdge = 0;    // [us]
+
+    EventResponder _event;
+    void (*_callback)(int32_t, int32_t) = nullptr;
+    void (*_buttonCallback)(bool) = nullptr;
+};
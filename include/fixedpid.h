@@ -0,0 +1,45 @@
+#pragma once
+#include <Arduino.h>
+#include "syncfilter.h"
+
+// Stand-in for QuickPID in fixed point (-D FIXED_PID), for the Teensy LC: its
+// Cortex-M0+ has no FPU, so every float operation of QuickPID is a library
+// call. Only the modes Audio uses are there - proportional and derivative on
+// measurement, integral clamped to the output limits - with the same results
+// as QuickPID's up to rounding. Input and setpoint are Q8 (sync error in
+// samples, see FIXED_Q), output is a whole number (ppm2). Gains are Q16, so
+// they can be set in much finer steps than whole numbers. The terms are kept
+// as Q8 and saturate rather than wrap around.
+class FixedPID {
+  public:
+    enum class Control : uint8_t { manual, timer };
+    enum class pMode : uint8_t { pOnMeas };
+    enum class dMode : uint8_t { dOnMeas };
+    enum class iAwMode : uint8_t { iAwClamp };
+
+    FixedPID(int32_t *input, int32_t *output, int32_t *setpoint)
+      : _input(input), _output(output), _setpoint(setpoint) {}
+    void SetMode(Control mode);
+    void SetProportionalMode(pMode) {}
+    void SetDerivativeMode(dMode) {}
+    void SetAntiWindupMode(iAwMode) {}
+    void SetTunings(float kp, float ki, float kd);    // as QuickPID: ki [1/s], kd [s]
+    void SetSampleTimeUs(uint32_t us) { _sampleTimeUs = us; }  // before SetTunings()
+    void SetOutputLimits(int32_t min, int32_t max);
+    bool Compute();
+    float GetPterm() const { return (float) _pTerm / (1L << FIXED_Q); }
+    float GetIterm() const { return (float) _iTerm / (1L << FIXED_Q); }
+    float GetDterm() const { return (float) _dTerm / (1L << FIXED_Q); }
+
+  private:
+    static int32_t multiply(int32_t gain, int32_t value);
+
+    int32_t *_input, *_output, *_setpoint;
+    Control _mode = Control::manual;
+    uint32_t _sampleTimeUs = 100000;      // as QuickPID
+    int32_t _kp = 0, _ki = 0, _kd = 0;    // per tick, Q16
+    int32_t _outMin = 0, _outMax = 255L << FIXED_Q;
+    int32_t _outputSum = 0;               // Q8
+    int32_t _lastInput = 0;
+    int32_t _pTerm = 0, _iTerm = 0, _dTerm = 0;
+};
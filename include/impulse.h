@@ -0,0 +1,71 @@
+#pragma once
+#include <Arduino.h>
+#include <SD.h>
+#include "ringbuffer.h"
+
+#define IMPULSE_BUFFER_N 32  // capacity of impulse timestamp buffer (power of two)
+#define IMPULSE_DEBOUNCE 2000 // minimum period between impulses [us] (500 Hz)
+
+// timestamps of impulses [us], drained by Audio::countImpulses()
+extern RingBuffer<uint32_t, IMPULSE_BUFFER_N> impulseBuffer;
+
+// Source of projector impulses. Implementations push one timestamp per
+// impulse into impulseBuffer between begin() and end(). Only differences of
+// timestamps are used, so the time base doesn't need to match micros() - as
+// long as now() tells the current time in it.
+class ImpulseSource {
+  public:
+    virtual void begin() = 0;
+    virtual void end() = 0;
+    virtual void poll() {}                // called from the main loop
+    virtual uint32_t now() { return micros(); }   // in the time base of the timestamps
+};
+
+// Pin change interrupt on IMPULSE, timestamped with micros() in the ISR.
+// The timestamp is subject to interrupt latency, e.g., while the DREQ
+// interrupt is being served.
+class ImpulseInterrupt : public ImpulseSource {
+  public:
+    void begin() override;
+    void end() override;
+  private:
+    static void isr();
+};
+
+// Input capture of the IMPULSE edge by a hardware timer. The counter value is
+// latched on the edge, so the timestamp is independent of interrupt latency.
+//
+//    Teensy LC:  Pin 02 = PTD0  -> TPM0_CH0
+//    Teensy 3.2: Pin 03 = PTA12 -> FTM1_CH0 (pin 02 has no FTM channel, so
+//                IMPULSE and STARTMARK need to be swapped in pins.h)
+//
+// Enable with -D IMPULSE_CAPTURE.
+#if defined(IMPULSE_CAPTURE)
+class ImpulseCapture : public ImpulseSource {
+  public:
+    void begin() override;
+    void end() override;
+    uint32_t now() override;
+};
+#endif
+
+// Replays impulse timestamps recorded in a file on the SD card (little endian
+// uint32, microseconds) from the start mark on, i.e., once STARTMARK is low
+// after begin() has been called. Allows for running the firmware against a
+// recorded projector - e.g., on the host.
+class ImpulseReplay : public ImpulseSource {
+  public:
+    ImpulseReplay(const char *filename) : _filename { filename } {}
+    void begin() override;
+    void end() override;
+    void poll() override;
+  private:
+    bool readNext();
+    const char *_filename;
+    File _file;
+    bool _valid = false;
+    bool _started = false;
+    uint32_t _startMicros = 0;
+    uint32_t _first = 0;
+    uint32_t _next = 0;
+};
@@ -8,23 +8,31 @@
 #define MENU_PROJECTOR_SELECT     12
 #define MENU_PROJECTOR_EDIT       13
 #define MENU_PROJECTOR_DELETE     14
+#define MENU_PROJECTOR_TUNE       15
 #define MENU_SELECT_TRACK         20
 
 #define MENU_EXTRAS               30
 #define MENU_EXTRAS_VERSION       31
 #define MENU_EXTRAS_IMPULSE       32
+#define MENU_EXTRAS_BUFFERS       33
+
+// the optional items move the ones below them
+#if defined(PROFILE)
+#define MENU_EXTRAS_PROFILE       34
+#define MENU_EXTRAS_NEXT          35
+#else
+#define MENU_EXTRAS_NEXT          34
+#endif
 
 #if defined(FORMAT_SD)
-#define MENU_EXTRAS_FORMAT_SD     33
-#define MENU_EXTRAS_DEL_EEPROM    34
+#define MENU_EXTRAS_FORMAT_SD     (MENU_EXTRAS_NEXT)
+#define MENU_EXTRAS_DEL_EEPROM    (MENU_EXTRAS_NEXT + 1)
 #else
-#define MENU_EXTRAS_DEL_EEPROM    33
+#define MENU_EXTRAS_DEL_EEPROM    (MENU_EXTRAS_NEXT)
 #endif
 
-#if (defined(SERIALDEBUG) || defined(HWSERIALDEBUG)) && !defined(FORMAT_SD)
-#define MENU_EXTRAS_DUMP_EEPROM   34
-#elif (defined(SERIALDEBUG) || defined(HWSERIALDEBUG)) && defined(FORMAT_SD)
-#define MENU_EXTRAS_DUMP_EEPROM   35
+#if defined(SERIALDEBUG) || defined(HWSERIALDEBUG)
+#define MENU_EXTRAS_DUMP_EEPROM   (MENU_EXTRAS_DEL_EEPROM + 1)
 #endif
 
 #define MENU_ITEM_MANUALSTART      1
@@ -44,6 +52,7 @@ const char *projector_action_menu =
   "Select\n"
   "Edit\n"
   "Delete\n"
+  "Auto-Tune\n"
   "Exit";
 
 const char *trackLoaded_menu =
@@ -54,6 +63,10 @@ const char *trackLoaded_menu =
 const char *extras_menu =
   "Version\n"
   "Test Impulse\n"
+  "Buffer Health\n"
+#if defined(PROFILE)
+  "CPU Profile\n"
+#endif
 #if defined(FORMAT_SD)
   "Format SD Card\n"
 #endif
@@ -0,0 +1,58 @@
+#pragma once
+#include <Arduino.h>
+#include <SD.h>
+
+#define SCAN_SECTOR      512   // the scanner reads at most up to the next sector boundary
+#define SCAN_MAX_LENGTH   16   // longest pattern
+
+union oggPage {
+  struct __attribute__((packed)) {
+    char     magicStr[4];
+    uint8_t  version;
+    uint8_t  headerType;
+    int64_t  granulePos;
+    uint32_t bitstreamSN;
+    uint32_t pageSeqNo;
+    uint32_t crc;
+    uint8_t  nSegments;
+  };
+  unsigned char header[27];
+};
+
+// Finds a byte pattern in a file. The pattern is binary (NUL is just another
+// byte), the file is read in blocks ending on sector boundaries and the
+// window is advanced by Horspool's rule: by the distance of its last byte
+// from the end of the pattern. A search for "OggS" reads each sector once
+// and looks at about every fourth byte.
+class StreamScanner {
+  public:
+    StreamScanner(const void *pattern, uint8_t length);
+    size_t find(File *file, size_t from) const;   // position of the pattern, UINT32_MAX if none
+
+  private:
+    const uint8_t *_pattern;
+    uint8_t _length;
+    uint8_t _skip[256];
+};
+
+// Walks the pages of an Ogg file. The next page is found through the lacing
+// values of the current one, so each page costs a seek and two small reads
+// regardless of its size. sync() finds the first page at or after an
+// arbitrary position, e.g., when bisecting.
+class OggWalker {
+  public:
+    OggWalker(File *file) : _file { file } {}
+    bool read(size_t pos);                        // page at pos, file is left at its payload
+    bool next() { return read(_next); }           // page following the current one
+    bool sync(size_t pos);                        // next page with a granule position
+
+    size_t position() const { return _pos; }
+    size_t nextPosition() const { return _next; }
+    int64_t granulePos() const { return page.granulePos; }  // -1: no packet ends on this page
+    oggPage page;
+
+  private:
+    File *_file;
+    size_t _pos  = UINT32_MAX;
+    size_t _next = 0;
+};
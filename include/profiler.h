@@ -0,0 +1,85 @@
+#pragma once
+#include <Arduino.h>
+
+// Where the CPU time and the SPI bus go during playback (-D PROFILE). Each
+// section keeps count, min, mean and max of the cycles it took per call, and
+// its share of the wall time between start() and stop() - the sum of the CPU
+// sections is what's left of the headroom. CPU sections are timed exclusive
+// of the sections nested in them: e.g., an impulse interrupt hitting a display
+// update counts for the impulse only. Bus sections are the time a device had
+// the SPI bus; they overlap with the CPU sections the bus was used by.
+//
+// Without -D PROFILE, the PROFILE_...() macros compile to nothing.
+#if defined(PROFILE)
+#include "cycles.h"
+
+#define PROFILE_SHOW_LINES 5              // sections on the display at a time
+
+enum ProfileSection : uint8_t {
+  PROFILE_IMPULSE,                        // impulse interrupt
+  PROFILE_FEEDER,                         // DREQ feeder, Audio::feed()
+  PROFILE_TICK,                           // PID tick interrupt
+  PROFILE_PID,                            // Audio::speedControlPID()
+  PROFILE_DISPLAY,                        // playing screen, incl. sendBuffer()
+  PROFILE_READ_AHEAD,                     // SD card reads (and session log writes)
+  PROFILE_ENCODER,                        // encoder interrupts and callbacks
+  PROFILE_MTP,                            // MTP.loop()
+  PROFILE_CPU_SECTIONS,
+  PROFILE_BUS_VS1053 = PROFILE_CPU_SECTIONS,  // SCI and SDI
+  PROFILE_BUS_SD,
+  PROFILE_BUS_DISPLAY,
+  PROFILE_SECTIONS
+};
+
+class Profiler {
+  public:
+    struct Stats {
+      uint32_t calls = 0;
+      uint32_t min = UINT32_MAX, max = 0; // [cycles]
+      uint64_t total = 0;                 // [cycles]
+    };
+
+    void start();                         // start of session, clears all sections
+    void stop();
+    void print() const;                   // over serial
+    void show() const;                    // on the display, until button is pressed
+
+    void enter(uint32_t &start, uint32_t &nested);
+    void leave(uint8_t section, uint32_t start, uint32_t nested);
+    void busBegin(uint8_t section);
+    void busEnd(uint8_t section);
+
+    Stats stats[PROFILE_SECTIONS];
+
+  private:
+    void add(uint8_t section, uint32_t cycles);
+    uint32_t percent(uint8_t section) const;  // of wall time [1/100 %]
+    void drawLine(uint8_t y, uint8_t section) const;
+
+    volatile bool _running = false;
+    uint32_t _nested = 0;                 // cycles of all CPU sections left so far
+    uint32_t _busStart[PROFILE_SECTIONS - PROFILE_CPU_SECTIONS] = {0};
+    uint32_t _startMicros = 0;
+    uint32_t _wallMicros = 0;
+};
+
+extern Profiler profiler;
+
+// times a CPU section until the end of the enclosing scope
+class ProfileScope {
+  public:
+    ProfileScope(uint8_t section) : _section(section) { profiler.enter(_start, _nested); }
+    ~ProfileScope() { profiler.leave(_section, _start, _nested); }
+  private:
+    uint8_t _section;
+    uint32_t _start, _nested;
+};
+
+#define PROFILE_SCOPE(section)     ProfileScope profileScope(section)
+#define PROFILE_BUS_BEGIN(section) profiler.busBegin(section)
+#define PROFILE_BUS_END(section)   profiler.busEnd(section)
+#else
+#define PROFILE_SCOPE(section)
+#define PROFILE_BUS_BEGIN(section)
+#define PROFILE_BUS_END(section)
+#endif
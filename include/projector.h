@@ -1,11 +1,13 @@
 #pragma once
 
 // A few macros for handling of the EEPROM storage
-#define EEPROM_HEADER_BYTES        2
+#define EEPROM_HEADER_BYTES        3
 #define EEPROM_IDX_COUNT           0
 #define EEPROM_IDX_LAST            1
+#define EEPROM_IDX_VERSION         2
+#define EEPROM_VERSION             7   // layout of the records, above 4 - see Projector::e2migrate()
 #define MAX_PROJECTOR_NAME_LENGTH  12
-#define EEPROM_BYTES_PER_PROJECTOR (MAX_PROJECTOR_NAME_LENGTH + 5)
+#define EEPROM_BYTES_PER_PROJECTOR 17  // EEPROMstruct packed - see Projector::e2save()
 #if defined(__MKL26Z64__)
   #define EEPROM_SIZE              128 // Teensy LC has only 128 bytes of EEPROM!
 #else
@@ -14,6 +16,21 @@
 #define MAX_PROJECTOR_COUNT        ((EEPROM_SIZE - EEPROM_HEADER_BYTES) / EEPROM_BYTES_PER_PROJECTOR)
 #define EEPROM_BYTES_REQUIRED      (EEPROM_BYTES_PER_PROJECTOR * MAX_PROJECTOR_COUNT + EEPROM_HEADER_BYTES)
 
+// Layouts 5 and 6: EEPROMstruct as is, 6 with hundredths of the PID gains
+#define EEPROM_V5_BYTES_PER_PROJECTOR (MAX_PROJECTOR_NAME_LENGTH + 7)
+#define EEPROM_V6_BYTES_PER_PROJECTOR (MAX_PROJECTOR_NAME_LENGTH + 10)
+
+// Legacy layout without version byte (firmware up to v1.0)
+#define EEPROM_V0_HEADER_BYTES     2
+#define EEPROM_V0_BYTES_PER_PROJECTOR (MAX_PROJECTOR_NAME_LENGTH + 6)
+#define EEPROM_V0_MAX_PROJECTORS   ((EEPROM_SIZE - EEPROM_V0_HEADER_BYTES) / (MAX_PROJECTOR_NAME_LENGTH + 5))
+
+// Filters for the sync error fed to the PID
+#define FILTER_AVERAGE             0   // moving average
+#define FILTER_TRACKER             1   // alpha-beta tracker of offset and rate
+
+// Layouts up to 6 stored this struct as is. New fields go to the end, so
+// these can still be migrated by copying their bytes.
 struct EEPROMstruct {
   uint8_t shutterBladeCount = 2;
   uint8_t startmarkOffset = 1;
@@ -21,6 +38,14 @@ struct EEPROMstruct {
   uint8_t i = 3;
   uint8_t d = 1;
   char name[MAX_PROJECTOR_NAME_LENGTH + 1] = {0};
+  uint8_t filter = FILTER_TRACKER;
+  uint8_t pFrac = 0;                     // hundredths of the gains
+  uint8_t iFrac = 0;
+  uint8_t dFrac = 0;
+
+  float kp() const { return p + pFrac / 100.0f; }
+  float ki() const { return i + iFrac / 100.0f; }
+  float kd() const { return d + dFrac / 100.0f; }
 };
 
 class Projector {
@@ -34,18 +59,22 @@ class Projector {
     void loadLast(void);                 // load last used projector
     void remove();                       // delete projector
     void remove(uint8_t);                // delete specific projector
+    void setGains(uint16_t, uint16_t, uint16_t); // store PID gains of current projector [1/100]
     uint8_t select(const char*);         // select projector
     uint8_t count(void);                 // get projector count
     uint8_t lastUsed(void);              // get last used projector
     void e2dump(void);                   // dump EEPROM to serial
     void e2delete(void);                 // delete EEPROM
     EEPROMstruct config(void) const&;    // return current projector's configuration
+    void e2save(uint8_t, EEPROMstruct&); // save projector struct to EEPROM
 
   private:
     EEPROMstruct config_;
     void count(uint8_t);                 // set projector count
     void lastUsed(uint8_t);              // set last used projector
     EEPROMstruct e2load(uint8_t);        // load projector struct from EEPROM
-    void e2save(uint8_t, EEPROMstruct&); // save projector struct to EEPROM
+    void e2migrate(void);                // convert EEPROM to current layout
+    bool e2valid(uint8_t, uint8_t, uint8_t); // records plausible in given layout?
     void editName(char*, const char*);
+    void editGain(const char*, uint8_t*, uint8_t*);
 };
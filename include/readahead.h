@@ -0,0 +1,40 @@
+#pragma once
+#include <Arduino.h>
+#include <SD.h>
+
+#if defined(__MKL26Z64__)                     // Teensy LC: 8 KB of RAM
+  #define READ_AHEAD_BYTES 2048
+#else
+  #define READ_AHEAD_BYTES 16384
+#endif
+#define READ_AHEAD_SECTOR 512
+
+// Read-ahead buffer between the SD card and the VS1053B's SDI feeder.
+//
+// The main loop fills the buffer in sector reads, the DREQ interrupt drains
+// it. Like RingBuffer, head and tail are free running and only ever written
+// by one side each. Buffer positions are congruent to file positions modulo
+// the sector size, so that every read after the first one is a whole,
+// aligned sector that is copied straight into the buffer.
+class ReadAhead {
+  static_assert(READ_AHEAD_BYTES % READ_AHEAD_SECTOR == 0, "READ_AHEAD_BYTES must be a multiple of the sector size");
+
+  public:
+    void clear(uint32_t filePos);             // only while consumer is inactive
+    void setDepth(uint16_t bytes);            // fill level to aim for
+    bool fill(File &file, uint32_t end = UINT32_MAX); // producer only, reads at most one sector, up to end
+
+    uint16_t peek(uint8_t *&data, uint16_t max); // consumer only, contiguous data
+    void consume(uint16_t n);
+
+    uint16_t available() const { return _head - _tail; }
+    uint16_t depth() const { return _depth; }
+    bool eof() const { return _eof; }
+
+  private:
+    uint8_t _buffer[READ_AHEAD_BYTES];
+    volatile uint32_t _head = 0;
+    volatile uint32_t _tail = 0;
+    uint16_t _depth = READ_AHEAD_BYTES;
+    volatile bool _eof = false;
+};
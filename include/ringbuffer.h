@@ -0,0 +1,51 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+
+// Lock-free ring buffer for exactly one producer (e.g., an ISR) and one
+// consumer (the main loop). Head and tail are free running and only ever
+// written by one side each, so neither side needs to disable interrupts.
+// If the buffer is full, new elements are dropped and counted as overruns.
+template <typename T, uint16_t N>
+class RingBuffer {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "size of RingBuffer must be a power of two");
+
+  public:
+    bool push(const T &value) {                 // producer only
+      uint32_t head = head_;
+      if (head - tail_ >= N) {
+        overruns_++;
+        return false;
+      }
+      buffer_[head & (N - 1)] = value;
+      std::atomic_signal_fence(std::memory_order_release);
+      head_ = head + 1;
+      return true;
+    }
+
+    bool pop(T &value) {                        // consumer only
+      uint32_t tail = tail_;
+      if (tail == head_)
+        return false;
+      std::atomic_signal_fence(std::memory_order_acquire);
+      value = buffer_[tail & (N - 1)];
+      std::atomic_signal_fence(std::memory_order_release);
+      tail_ = tail + 1;
+      return true;
+    }
+
+    uint16_t available() const { return head_ - tail_; }
+    uint32_t overruns() const { return overruns_; }
+    uint32_t pushed() const { return head_ + overruns_; }   // all pushes, overruns included
+
+    void clear() {                              // only while producer is inactive
+      tail_ = head_;
+      overruns_ = 0;
+    }
+
+  private:
+    T buffer_[N];
+    volatile uint32_t head_ = 0;
+    volatile uint32_t tail_ = 0;
+    volatile uint32_t overruns_ = 0;
+};
@@ -0,0 +1,39 @@
+#pragma once
+#include <Arduino.h>
+
+class SdiBus;
+
+// Serial control interface (SCI) of the VS1053B for use in the hot path.
+//
+// Compared to Adafruit_VS1053::sciRead()/sciWrite() this runs the bus at a
+// higher clock, holds on to the SPI bus (and thereby keeps the DREQ feeder
+// away) for a whole burst of operations, and uses multiple writes to the same
+// register with XCS held low as well as the auto-increment of WRAMADDR.
+class SciBus {
+  public:
+    SciBus(uint8_t cs, SdiBus *sdi = nullptr) : _cs { cs }, _sdi { sdi } {}
+    void begin();
+
+    void beginBurst();                    // claim the bus for several operations
+    void endBurst();
+
+    uint16_t read(uint8_t addr);
+    void write(uint8_t addr, uint16_t data);
+    void write(uint8_t addr, const uint16_t *data, uint8_t n);  // multiple write
+
+    // WRAM access, consecutive addresses
+    void readWRAM(uint16_t addr, uint16_t *data, uint8_t n);
+    void writeWRAM(uint16_t addr, const uint16_t *data, uint8_t n);
+
+    // statistics
+    uint32_t bytes = 0;                   // bytes transferred on the bus
+    uint32_t busMicros = 0;               // time the bus was claimed [us]
+
+  private:
+    void select();
+    void deselect();
+    const uint8_t _cs;
+    SdiBus *_sdi;                         // held during bursts (see sdi.h)
+    uint8_t _depth = 0;                   // nesting of bursts
+    uint32_t _burstStart = 0;
+};
@@ -0,0 +1,45 @@
+#pragma once
+#include <Arduino.h>
+
+// Serial data interface (SDI) of the VS1053B, fed by DMA.
+//
+// Each chunk (up to the 32 bytes the VS1053B accepts per DREQ) is written to
+// the SPI data register by a DMA channel. The CPU only sets up the transfer
+// and takes one interrupt when it has completed, which calls sent() and then
+// ready() - where the next chunk can be started if DREQ is still high.
+//
+// The SPI bus is shared with the SD card, the display and SCI: other users
+// need to hold() the SDI feeder for as long as they use the bus. The DMA
+// interrupt is registered with SPI.usingInterrupt(), so that transactions of
+// unaware users (e.g., libraries) at least don't start another chunk.
+//
+// Enable with -D SDI_DMA.
+#if defined(SDI_DMA)
+#include <DMAChannel.h>
+
+class SdiBus {
+  public:
+    SdiBus(uint8_t dcs) : _dcs { dcs } {}
+    void begin(void (*sent)(uint8_t), void (*ready)());
+
+    bool send(const uint8_t *data, uint8_t n);  // start a chunk, false if busy or held
+    bool busy() const { return _busy; }
+
+    void hold();                          // wait for chunk in flight, don't start new ones
+    void release();
+
+    // statistics
+    uint32_t chunks = 0;                  // number of chunks sent
+
+  private:
+    static void isr();
+    void finish();
+    const uint8_t _dcs;
+    DMAChannel _dma;
+    void (*_sent)(uint8_t) = nullptr;
+    void (*_ready)() = nullptr;
+    volatile bool _busy = false;
+    volatile uint8_t _held = 0;           // nesting of hold()
+    uint8_t _n = 0;                       // size of chunk in flight
+};
+#endif
@@ -0,0 +1,83 @@
+#pragma once
+#include <Arduino.h>
+#include <SD.h>
+
+#if defined(SESSION_LOG) && defined(__MKL26Z64__)
+  #undef SESSION_LOG                      // Teensy LC: no RAM to spare for the buffers
+#endif
+
+#define LOG_SECTOR        512
+#define LOG_VERSION         1             // of the file format, see tools/synclog.py
+#define LOG_SYNC_SECTORS   64             // directory entry updated every n sectors (~100 s)
+#if !defined(SESSION_LOG_MB)
+  #define SESSION_LOG_MB    4             // preallocated, a little over three hours
+#endif
+
+// flags of a logRecord
+#define LOG_RAMP         0x01             // feed-forward from the last few impulses (run-down/-up)
+#define LOG_TUNE         0x02             // relay of the auto-tune in place of the PID
+
+// First sector of the file, written when the log is opened and again, with
+// the totals, when it is closed.
+struct __attribute__((packed)) logHeader {
+  char     magic[8] = "SYNKLOG";
+  uint8_t  version = LOG_VERSION;
+  uint8_t  recordSize;
+  uint16_t track;
+  uint16_t fs;                            // [Hz]
+  uint16_t fpsNum, fpsDen;                // frame rate as a fraction
+  uint8_t  blades;
+  uint8_t  filter;                        // FILTER_AVERAGE or FILTER_TRACKER
+  uint8_t  p, i, d;
+  char     projector[13];
+  uint32_t tickMicros;                    // PID sample time
+  uint32_t startFrame;
+  uint32_t decoderLatency;                // [us]
+  uint32_t records;                       // written, 0 until closed
+  uint32_t dropped;                       // records lost to a busy card
+  uint8_t  pFrac, iFrac, dFrac;           // hundredths of the gains (0 in older logs)
+};
+
+// One per PID tick. Sample counts and sync error as seen by the PID: from the
+// start of the track, audio ahead of the film is positive.
+struct __attribute__((packed)) logRecord {
+  uint32_t micros;                        // PID tick
+  uint32_t impulses;                      // totalImpCounter
+  uint32_t samples;                       // heard
+  int32_t  delta;                         // raw sync error [samples]
+  float    input;                         // filtered sync error [samples]
+  float    output;                        // PID output [ppm2]
+  int16_t  syncOffset;                    // set by the user [impulses]
+  uint16_t underflows;                    // audio buffer, total
+  uint8_t  readAhead, stream, audio;      // buffer fill levels [%]
+  uint8_t  flags;                         // LOG_RAMP, LOG_TUNE
+};
+
+// Log of a playback session on the SD card. add() only copies a record to one
+// half of a RAM double buffer, flush() writes the other half once it's full:
+// a whole sector at a time into a file allocated contiguously beforehand, so
+// the card doesn't have to look for free clusters or update the FAT while the
+// film is running. Records that find both halves full are dropped and counted.
+class SessionLog {
+  static_assert(LOG_SECTOR % sizeof(logRecord) == 0, "records must not straddle sectors");
+  static_assert(sizeof(logHeader) <= LOG_SECTOR, "header must fit a sector");
+
+  public:
+    bool begin(const char *name, logHeader header);
+    void add(const logRecord &record);    // RAM only
+    bool pending() const { return _full[0] || _full[1]; }
+    void flush();                         // writes at most one sector
+    void end(logHeader header);           // the rest, header with totals
+    bool active() const { return _file.isOpen(); }
+
+  private:
+    bool writeSector(const uint8_t *data);
+    FsFile _file;
+    uint8_t _buffer[2][LOG_SECTOR];
+    uint16_t _used = 0;                   // bytes in _buffer[_fill]
+    uint8_t _fill = 0;                    // half that records go to
+    bool _full[2] = {false, false};
+    uint32_t _sectors = 0;                // of records written
+    uint32_t _records = 0;
+    uint32_t _dropped = 0;
+};
@@ -0,0 +1,54 @@
+#pragma once
+#include <Arduino.h>
+
+#define PID_FILTER_N            10
+#define TRACKER_ALPHA         0.30f   // gain for offset
+#define TRACKER_BETA          (TRACKER_ALPHA * TRACKER_ALPHA / (2 - TRACKER_ALPHA)) // gain for rate
+#define FIXED_Q                  8    // fraction bits of sync errors in fixed point (Q8 samples)
+
+// Filters for the sync error fed to the PID, once per tick. Sync errors are
+// given in samples, audio ahead of the film is positive.
+
+// Moving average over the last PID_FILTER_N ticks. The running total is
+// 32 bits wide: that's plenty for sync errors of a few seconds, and spares
+// the Teensy LC a 64 bit division every tick.
+class MovingAverage {
+  public:
+    int32_t add(int32_t error);           // [samples]
+    void clear();
+
+  private:
+    int32_t _readings[PID_FILTER_N] = {0};
+    int32_t _total = 0;
+    uint8_t _idx = 0;
+};
+
+// Alpha-beta filter - i.e., a two-state Kalman filter of offset and rate in
+// steady state (beta follows from alpha as proposed by Benedict & Bordner).
+// Contrary to the moving average, the estimate isn't delayed by the filter:
+// the offset is predicted to the current tick using the estimated rate.
+class Tracker {
+  public:
+    float add(int32_t error);             // [samples]
+    void clear() { _offset = _rate = 0; }
+    void clearRate() { _rate = 0; }
+
+  private:
+    float _offset = 0;                    // [samples]
+    float _rate = 0;                      // [samples / PID tick]
+};
+
+// The same in fixed point, for CPUs without FPU. Offset and rate are Q8
+// samples, so is the estimate returned.
+class FixedTracker {
+  public:
+    int32_t add(int32_t error);           // [samples] -> [samples, Q8]
+    void clear() { _offset = _rate = 0; }
+    void clearRate() { _rate = 0; }
+
+  private:
+    static constexpr int32_t alpha = (int32_t) (TRACKER_ALPHA * 65536 + 0.5f);  // Q16
+    static constexpr int32_t beta  = (int32_t) (TRACKER_BETA  * 65536 + 0.5f);
+    int32_t _offset = 0;
+    int32_t _rate = 0;
+};
@@ -0,0 +1,68 @@
+#pragma once
+#include <Arduino.h>
+#include "ringbuffer.h"
+#include "serialdebug.h"
+
+#if defined(MYSERIAL)
+  #define TELEMETRY_PORT MYSERIAL         // shared with the debug output
+#else
+  #define TELEMETRY_PORT Serial1          // TX on pin 1
+#endif
+#define TELEMETRY_BAUD      31250         // as MYSERIAL, see main.cpp
+#define TELEMETRY_BUFFER      256         // TX ring buffer [bytes]
+#define TELEMETRY_MAX_PAYLOAD  64
+
+// record types
+#define TELEMETRY_SESSION       1         // telemetrySession, at the start of playback
+#define TELEMETRY_TICK          2         // telemetryTick, every PID tick
+
+// flags of a telemetryTick
+#define TELEMETRY_RAMP       0x01         // feed-forward from the last few impulses (run-down/-up)
+#define TELEMETRY_TUNE       0x02         // relay of the auto-tune in place of the PID
+
+struct __attribute__((packed)) telemetrySession {
+  uint16_t track;
+  uint16_t fs;                            // [Hz]
+  uint16_t fpsNum, fpsDen;                // frame rate as a fraction
+  uint8_t  blades;
+  uint8_t  filter;                        // FILTER_AVERAGE or FILTER_TRACKER
+  uint8_t  p, i, d;
+  uint32_t startFrame;
+  uint8_t  pFrac, iFrac, dFrac;           // hundredths of the gains
+};
+
+struct __attribute__((packed)) telemetryTick {
+  uint32_t micros;                        // PID tick
+  uint32_t impulses;                      // totalImpCounter
+  int32_t  delta;                         // raw sync error [samples], audio ahead > 0
+  float    input;                         // filtered sync error [samples]
+  float    frames;                        // ... [frames]
+  float    pTerm, iTerm, dTerm;           // of the PID ...
+  float    output;                        // ... and its output [ppm2]
+  float    feedForward;                   // projector speed [ppm2]
+  uint16_t sciMicros;                     // SCI bus time since the previous tick
+  uint8_t  readAhead, stream, audio;      // buffer fill levels [%]
+  uint8_t  flags;                         // TELEMETRY_RAMP, TELEMETRY_TUNE
+};
+
+// Binary telemetry over the serial port. A record is sent as a frame of
+// type, sequence number, the record and a CRC-16/CCITT of all that, COBS
+// encoded and terminated by a zero byte - which can't occur in the frame
+// itself, so the receiver can pick up at any frame boundary and tell text
+// from the debug output (never zero) from frames by the CRC. send() only
+// copies the frame to a ring buffer, pump() passes on as much of it as the
+// port takes without blocking. A frame that doesn't fit is dropped whole and
+// shows as a gap in the sequence numbers. See tools/telemetry.py.
+class Telemetry {
+  public:
+    void begin();
+    bool send(uint8_t type, const void *record, uint8_t length);
+    void pump();                          // main loop
+    uint32_t dropped() const { return _dropped; }
+
+  private:
+    static uint16_t crc16(const uint8_t *data, uint8_t length);
+    RingBuffer<uint8_t, TELEMETRY_BUFFER> _tx;
+    uint8_t _seq = 0;
+    uint32_t _dropped = 0;
+};
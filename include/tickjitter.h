@@ -0,0 +1,24 @@
+#pragma once
+#include <Arduino.h>
+
+// Timing of the PID ticks during playback. The sample counter is read by the
+// tick timer's interrupt, which is held off while another transaction has
+// the SPI bus, so the period between samples deviates from the nominal one
+// by at most the longest transaction. The PID computes later, in the main
+// loop, and that delay is kept track of as well.
+class TickJitter {
+  public:
+    void clear(uint32_t nominal);         // start of session [us]
+    void add(uint32_t period, uint32_t delay);  // per tick: since the previous sample, sample to compute [us]
+    void print() const;                   // over serial
+    float rms() const;                    // deviation of the period [us]
+
+    uint32_t ticks = 0;
+    uint32_t shortest = 0, longest = 0;   // period [us]
+    uint32_t maxDelay = 0;                // sample to compute [us]
+
+  private:
+    uint32_t _nominal = 0;
+    uint64_t _sumSquares = 0;             // of deviations of the period [us^2]
+    uint64_t _sumDelay = 0;
+};
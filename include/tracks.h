@@ -0,0 +1,42 @@
+#pragma once
+#include <Arduino.h>
+
+#if defined(__MKL26Z64__)                 // Teensy LC: 512 byte table, to fit in 8 KB of RAM
+  #define TRACKS_MAX  128
+#else
+  #define TRACKS_MAX 1000
+#endif
+
+#define FPS_NAME_LENGTH 7                 // "23.976" and NUL
+
+// Frames per second as a fraction, e.g., 24/1, 50/3 (16 2/3) or 24000/1001
+// (23.976), so that frames convert to samples without rounding.
+struct frameRate {
+  uint16_t num = 0;
+  uint16_t den = 1;
+};
+
+// Table of the tracks on the SD card, built by a single pass over the root
+// directory. Names like "001-24.ogg", "001-24-L.ogg" or "001-23.976.ogg" are
+// parsed into track number, frame rate and loop flag and kept sorted, so that
+// looking up a track is a binary search rather than probing the card for every
+// possible name. Where a track exists more than once, the entry found first is
+// the one Audio::loadTrack() used to pick: no loop before loop, lower fps first.
+class TrackDirectory {
+  public:
+    bool scan();                          // false if the table is incomplete
+    bool find(uint16_t track, char *fps, bool *loop) const;  // fps as in the name
+    bool valid() const { return _valid; }        // scanned
+    bool complete() const { return _complete; }  // all tracks fit the table
+    uint16_t count() const { return _n; }
+    static bool rate(const char *fps, frameRate *rate);
+
+  private:
+    static bool parse(const char *name, uint32_t *entry);
+    static bool parseFps(const char *text, size_t len, uint16_t *milli, uint8_t *decimals);
+    uint16_t lowerBound(uint32_t key) const;
+    uint32_t _entries[TRACKS_MAX];        // track << 20 | loop << 19 | fps * 1000 << 2 | decimals
+    uint16_t _n = 0;
+    bool _valid = false;
+    bool _complete = false;
+};
@@ -1,8 +1,7 @@
 #pragma once
 
 #include <U8g2lib.h>
-#include <EncoderTool.h>
-using namespace EncoderTool;
+#include "encoder.h"
 
 #include "buzzer.h"
 #include "xbm.h"
@@ -11,7 +10,7 @@ using namespace EncoderTool;
 
 extern Buzzer buzzer;
 extern U8G2* u8g2;
-extern PolledEncoder enc;
+extern RotaryEncoder enc;
 extern int8_t encDir;
 
 class UI {
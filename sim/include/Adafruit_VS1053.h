@@ -0,0 +1,65 @@
+#pragma once
+// Stand-in for the Adafruit VS1053 library (env:native only). All accesses
+// are forwarded to the simulated VS1053B in sim/src/vs1053Model.cpp, data is
+// fed from the DREQ interrupt like in the original library.
+
+#include <Arduino.h>
+#include <SD.h>
+
+#define VS1053_FILEPLAYER_TIMER0_INT 255
+#define VS1053_FILEPLAYER_PIN_INT    5
+
+#define VS1053_REG_MODE       0x00
+#define VS1053_REG_STATUS     0x01
+#define VS1053_REG_BASS       0x02
+#define VS1053_REG_CLOCKF     0x03
+#define VS1053_REG_DECODETIME 0x04
+#define VS1053_REG_AUDATA     0x05
+#define VS1053_REG_WRAM       0x06
+#define VS1053_REG_WRAMADDR   0x07
+#define VS1053_REG_HDAT0      0x08
+#define VS1053_REG_HDAT1      0x09
+#define VS1053_REG_VOLUME     0x0B
+
+#define VS1053_DATABUFFERLEN  32
+
+class Adafruit_VS1053 {
+  public:
+    Adafruit_VS1053(int8_t, int8_t, int8_t dcs, int8_t dreq) : _dcs(dcs), _dreq(dreq) {}
+    uint8_t begin(void);
+    void reset(void) {}
+    void softReset(void) {}
+    uint16_t sciRead(uint8_t addr);
+    void sciWrite(uint8_t addr, uint16_t data);
+    void setVolume(uint8_t left, uint8_t right);
+    bool readyForData(void);
+    void playData(uint8_t *buffer, uint8_t buffsiz);
+    void GPIO_pinMode(uint8_t, uint8_t) {}
+    bool GPIO_digitalRead(uint8_t i) { return i == 1; }  // revision B
+    void GPIO_digitalWrite(uint8_t, uint8_t) {}
+  protected:
+    uint8_t _dcs;
+    uint8_t _dreq;
+};
+
+class Adafruit_VS1053_FilePlayer : public Adafruit_VS1053 {
+  public:
+    Adafruit_VS1053_FilePlayer(int8_t rst, int8_t cs, int8_t dcs, int8_t dreq, int8_t cardCS)
+      : Adafruit_VS1053(rst, cs, dcs, dreq) {}
+    bool begin(void);
+    bool useInterrupt(uint8_t type);
+    bool startPlayingFile(const char *trackname);
+    bool playFullFile(const char *trackname);
+    void feedBuffer(void);
+    void stopPlaying(void);
+    bool paused(void);
+    bool stopped(void);
+    void pausePlaying(bool pause);
+
+    File currentTrack;
+    volatile bool playingMusic = false;
+    uint8_t mp3buffer[VS1053_DATABUFFERLEN];
+
+  private:
+    volatile bool feedBufferLock = false;
+};
@@ -0,0 +1,110 @@
+#pragma once
+// Minimal stand-in for the Teensyduino core (env:native only)
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include "sim.h"
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+typedef struct {                          // as in Teensyduino's core
+  uint8_t sec, min, hour, wday, mday, mon, year;  // mon 0..11, year since 1900
+} DateTimeFields;
+
+#define HIGH              1
+#define LOW               0
+#define INPUT             0
+#define OUTPUT            1
+#define INPUT_PULLUP      2
+#define INPUT_PULLDOWN    3
+#define OUTPUT_OPENDRAIN  4
+#define INPUT_DISABLE     5
+#define CHANGE            4
+#define FALLING           2
+#define RISING            3
+#define LED_BUILTIN      13
+#define HEX              16
+#define DEC              10
+#define F_CPU             48000000   // as the Teensy LC
+
+#define bitSet(value, bit)   ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bitRead(value, bit)  (((value) >> (bit)) & 0x01)
+#define PI 3.1415926535897932384626433832795
+#define constrain(amt, low, high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+// time
+uint32_t micros();
+uint32_t millis();
+void delay(uint32_t);
+void delayMicroseconds(uint32_t);
+void yield();
+
+// pins & interrupts
+void pinMode(uint8_t, uint8_t);
+bool digitalRead(uint8_t);
+void digitalWrite(uint8_t, uint8_t);
+void attachInterrupt(uint8_t, void (*)(void), int);
+void detachInterrupt(uint8_t);
+#define digitalPinToInterrupt(pin) (pin)
+inline bool digitalReadFast(uint8_t pin) { return digitalRead(pin); }
+inline void digitalWriteFast(uint8_t pin, uint8_t val) { digitalWrite(pin, val); }
+inline void digitalToggleFast(uint8_t pin) { digitalWrite(pin, !digitalRead(pin)); }
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+// misc
+long random(long);
+long random(long, long);
+void tone(uint8_t, uint16_t, uint32_t = 0);
+void noTone(uint8_t);
+
+inline char *itoa(int value, char *str, int base) {
+  char *p = str;
+  unsigned int v = (value < 0 && base == 10) ? -value : value;
+  do {
+    int d = v % base;
+    *p++ = d < 10 ? '0' + d : 'a' + d - 10;
+  } while (v /= base);
+  if (value < 0 && base == 10)
+    *p++ = '-';
+  *p = '\0';
+  std::reverse(str, p);
+  return str;
+}
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t) { return 1; }
+    size_t print(const char *s)             { return strlen(s); }
+    size_t print(char)                      { return 1; }
+    size_t print(int n, int = DEC)          { return printNumber(n); }
+    size_t print(unsigned int n, int = DEC) { return printNumber(n); }
+    size_t print(long n, int = DEC)         { return printNumber(n); }
+    size_t print(unsigned long n, int = DEC){ return printNumber(n); }
+    size_t print(double n, int = 2)         { return printNumber((long) n); }
+    template <typename T> size_t println(T n) { return print(n) + 1; }
+    size_t println()                        { return 1; }
+  private:
+    size_t printNumber(long n) { char buf[12]; return snprintf(buf, sizeof(buf), "%ld", n); }
+};
+
+// Hardware serial port: bytes leave the TX FIFO (64 bytes, as on Teensy) at
+// the baud rate set by begin(), writing to a full FIFO waits. Everything sent
+// is kept in sim::serialOut.
+class HardwareSerial : public Print {
+  public:
+    void begin(uint32_t baud) { baud_ = baud; }
+    int availableForWrite();
+    size_t write(uint8_t) override;
+  private:
+    uint32_t baud_ = 0;
+    uint64_t idleAt_ = 0;                 // when the FIFO will be empty [µs]
+};
+extern HardwareSerial Serial1;
@@ -0,0 +1,56 @@
+#pragma once
+// Stand-in for Teensyduino's DMAChannel (env:native only), restricted to what
+// SDI via DMA needs: memory to SPI data register, triggered by the SPI
+// transmitter. The bytes are sent to the selected device(s) at the clock of
+// the last SPI transaction, the completion interrupt behaves like a pin
+// interrupt (and can be masked by SPI transactions). Every transfer is
+// recorded in sim::dmaLog.
+
+#include <Arduino.h>
+#include <vector>
+#include "sim.h"
+
+#define DMAMUX_SOURCE_SPI0_TX 17
+#define IRQ_DMA_CH0           48          // numbered after the pins
+
+typedef uint8_t IRQ_NUMBER_t;
+
+extern volatile uint8_t SPI0_DL;          // SPI data register
+
+namespace sim {
+  struct DmaTransfer {
+    uint64_t start;                       // [us]
+    uint64_t end;                         // [us]
+    uint16_t bytes;
+  };
+  extern std::vector<DmaTransfer> dmaLog;
+  extern bool dmaActive;                  // a transfer to SPI is in progress
+  extern uint32_t spiCollisions;          // SPI used by the CPU during a transfer
+}
+
+class DMAChannel : public sim::EventSource {
+  public:
+    DMAChannel();
+    void sourceBuffer(const volatile uint8_t *p, uint32_t n) { src_ = (const uint8_t*) p; n_ = n; }
+    void destination(volatile uint8_t &reg) { dst_ = &reg; }
+    void triggerAtHardwareEvent(uint8_t source) { trigger_ = source; }
+    void disableOnCompletion() {}
+    void interruptAtCompletion() { irq_ = true; }
+    void attachInterrupt(void (*isr)(void));
+    void enable();
+    void disable() { end_ = UINT64_MAX; }
+    bool complete();
+    void clearComplete() { complete_ = false; }
+    void clearInterrupt();
+    uint8_t channel;
+  private:
+    uint64_t nextEvent() override { return end_; }
+    void handleEvent() override;
+    const uint8_t *src_ = nullptr;
+    uint32_t n_ = 0;
+    volatile uint8_t *dst_ = nullptr;
+    uint8_t trigger_ = 0;
+    bool irq_ = false;
+    bool complete_ = false;
+    uint64_t end_ = UINT64_MAX;
+};
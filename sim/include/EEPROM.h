@@ -0,0 +1,18 @@
+#pragma once
+// Stand-in for the EEPROM library (env:native only)
+
+#include <Arduino.h>
+
+class EEPROMClass {
+  public:
+    uint8_t read(int idx) { return data_[idx]; }
+    void write(int idx, uint8_t val) { data_[idx] = val; }
+    void update(int idx, uint8_t val) { data_[idx] = val; }
+    uint16_t length() { return sizeof(data_); }
+    template <typename T> T &get(int idx, T &t) { memcpy(&t, &data_[idx], sizeof(T)); return t; }
+    template <typename T> const T &put(int idx, const T &t) { memcpy(&data_[idx], &t, sizeof(T)); return t; }
+  private:
+    uint8_t data_[256] = {0};
+};
+
+extern EEPROMClass EEPROM;
@@ -0,0 +1,15 @@
+#pragma once
+// Stand-in for Teensyduino's EventResponder (env:native only). Events are
+// only triggered by the encoder, which is never touched during a simulation
+// run - the function is simply called right away instead of from yield().
+
+class EventResponder;
+typedef EventResponder& EventResponderRef;
+
+class EventResponder {
+  public:
+    void attach(void (*fn)(EventResponderRef)) { fn_ = fn; }
+    void triggerEvent(int = 0, void * = nullptr) { if (fn_) fn_(*this); }
+  private:
+    void (*fn_)(EventResponderRef) = nullptr;
+};
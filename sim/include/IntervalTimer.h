@@ -0,0 +1,44 @@
+#pragma once
+// Stand-in for Teensyduino's IntervalTimer (env:native only). Unlike the TCK
+// timers of TeensyTimerTool, it fires at its exact time while the firmware is
+// busy, like a hardware interrupt. The interrupt behaves like a pin interrupt
+// (and can be masked by SPI transactions) of the lowest priority: it waits for
+// other handlers to return. Only one instance is supported.
+
+#include <Arduino.h>
+#include "sim.h"
+
+#define IRQ_PIT               56          // numbered after the pins and DMA channels
+
+typedef uint8_t IRQ_NUMBER_t;
+
+class IntervalTimer : public sim::EventSource {
+  public:
+    bool begin(void (*isr)(void), uint32_t us) {
+      attachInterrupt(IRQ_PIT, isr, RISING);
+      period_ = us;
+      due_ = next_ = sim::now + us;
+      return true;
+    }
+    void end() {
+      next_ = UINT64_MAX;
+      detachInterrupt(IRQ_PIT);
+    }
+    void priority(uint8_t) {}
+    operator IRQ_NUMBER_t() const { return IRQ_PIT; }
+  private:
+    uint64_t nextEvent() override { return next_; }
+    void handleEvent() override {
+      if (sim::inInterrupt()) {
+        next_ = sim::now + 1;
+        return;
+      }
+      due_ += period_;
+      next_ = due_;
+      sim::setPin(IRQ_PIT, HIGH);
+      sim::setPin(IRQ_PIT, LOW);
+    }
+    uint32_t period_ = 0;
+    uint64_t due_ = UINT64_MAX;
+    uint64_t next_ = UINT64_MAX;
+};
@@ -0,0 +1,96 @@
+#pragma once
+// Stand-in for the SD library (env:native only). Files live in memory and are
+// registered by the simulation via sim::sdAddFile().
+
+#include <Arduino.h>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+
+#define O_READ     0x00
+#define FILE_READ  O_READ
+#define FILE_WRITE 0x02
+#define O_WRONLY   0x01
+#define O_CREAT    0x40
+#define O_TRUNC    0x200
+
+namespace sim {
+  struct SdFile {
+    std::string data;                         // file content
+    uint64_t size;                            // may exceed data (rest reads as zeros ...
+    std::function<void(uint64_t, uint8_t*, size_t)> content;  // ... or is generated)
+    uint32_t modified;                        // [s] since 2020, at sdAddFile()
+  };
+  void sdAddFile(const char*, const std::string&, uint64_t = 0);
+  std::shared_ptr<SdFile> sdFind(const char*);
+  const char *sdName(size_t);                 // of the i-th file, nullptr if none
+  bool sdRemove(const char*);
+
+  // timing of the simulated card
+  struct SdLatency {
+    uint32_t sectorUs   = 400;                // reading a sector (SPI bus held)
+    uint32_t spikeUs    = 0;                  // duration of latency spikes
+    uint32_t spikeEvery = 1000;               // ... on average every n sectors
+    uint32_t spikes     = 0;                  // number of spikes so far
+    uint64_t reads      = 0;                  // number of File::read() calls ...
+    uint64_t sectors    = 0;                  // ... and sectors accessed on the card
+    std::mt19937 rng;
+  };
+  extern SdLatency sdLatency;
+}
+
+class File {
+  public:
+    File() {}
+    File(std::shared_ptr<sim::SdFile> f, const char *name) : f_(f), name_(name) {}
+    operator bool() const { return f_ || dir_; }
+    int read(void *buf, size_t n);
+    int read() { uint8_t b; return (read(&b, 1) == 1) ? b : -1; }
+    size_t write(const void *buf, size_t n);
+    bool getModifyTime(DateTimeFields &tm);
+    bool seek(uint64_t pos) { if (!f_ || pos > f_->size) return false; pos_ = pos; return true; }
+    uint64_t position() const { return pos_; }
+    uint64_t size() const { return f_ ? f_->size : 0; }
+    int available() const { return f_ ? (int) std::min<uint64_t>(f_->size - pos_, INT32_MAX) : 0; }
+    const char *name() const { return name_.c_str(); }
+    bool isDirectory() const { return dir_; }
+    File openNextFile();                      // of the root directory
+    void close() { f_.reset(); sector_ = UINT64_MAX; dir_ = false; }
+  protected:
+    void access(uint64_t from, uint64_t to);  // simulate timing
+    uint64_t sector_ = UINT64_MAX;            // cached sector
+    std::shared_ptr<sim::SdFile> f_;
+    std::string name_;
+    uint64_t pos_ = 0;
+    bool dir_ = false;
+    size_t next_ = 0;                         // next entry of the directory
+    friend class SDClass;
+};
+
+// SdFat's file, as used for writing whole sectors to a preallocated file
+class FsFile : public File {
+  public:
+    using File::File;
+    bool isOpen() const { return *this; }
+    bool preAllocate(uint64_t) { return isOpen(); }
+    bool sync() { return isOpen(); }
+    bool truncate();                          // at the current position
+};
+
+class SdFs {
+  public:
+    FsFile open(const char *name, int oflag);
+    bool remove(const char *name) { return sim::sdRemove(name); }
+};
+
+class SDClass {
+  public:
+    SdFs sdfs;
+    bool begin(uint8_t) { return true; }
+    bool exists(const char *name) { return (bool) sim::sdFind(name); }
+    File open(const char *name, uint8_t mode = O_READ);    // FILE_WRITE: create, append; "/"
+    bool remove(const char *name) { return sim::sdRemove(name); }
+};
+
+extern SDClass SD;
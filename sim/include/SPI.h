@@ -0,0 +1,38 @@
+#pragma once
+// Stand-in for the SPI library (env:native only). Bytes are passed on to the
+// simulated device whose chip select is low (see sim::SpiDevice), and the
+// firmware is busy for the duration of the transfer.
+
+#include <Arduino.h>
+#include <algorithm>
+#include <vector>
+
+#define MSBFIRST  1
+#define SPI_MODE0 0x00
+
+class SPISettings {
+  public:
+    SPISettings(uint32_t clock = 4000000, uint8_t = MSBFIRST, uint8_t = SPI_MODE0) : clock(clock) {}
+    uint32_t clock;
+};
+
+class SPIClass {
+  public:
+    void begin() {}
+    void usingInterrupt(uint8_t pin) { masks_.push_back(pin); }
+    void notUsingInterrupt(uint8_t pin) { masks_.erase(std::remove(masks_.begin(), masks_.end(), pin), masks_.end()); }
+    void beginTransaction(const SPISettings &settings);  // masks registered interrupts
+    void endTransaction();
+    uint8_t transfer(uint8_t);
+    uint32_t clock() const { return clock_; }
+    void shift(const uint8_t*, uint32_t n);   // bytes sent by DMA, no CPU time
+    void setMOSI(uint8_t) {}
+    void setMISO(uint8_t) {}
+    void setSCK(uint8_t) {}
+  private:
+    uint32_t clock_ = 4000000;
+    uint32_t ns_ = 0;                         // fraction of a microsecond
+    std::vector<uint8_t> masks_;
+};
+
+extern SPIClass SPI;
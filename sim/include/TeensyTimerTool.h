@@ -0,0 +1,52 @@
+#pragma once
+// Stand-in for TeensyTimerTool (env:native only). All timers behave like TCK
+// timers, i.e., they are only serviced from within yield().
+
+#include <functional>
+#include "sim.h"
+
+namespace TeensyTimerTool {
+
+enum TimerGenerator { TCK, TCK32, TCK64, FTM0, FTM1, FTM2, TPM0, TPM1, TPM2 };
+typedef std::function<void(void)> callback_t;
+
+// time literals return periods in microseconds
+constexpr double operator""_Hz(unsigned long long f)  { return 1E6 / f; }
+constexpr double operator""_Hz(long double f)         { return 1E6 / f; }
+constexpr double operator""_kHz(unsigned long long f) { return 1E3 / f; }
+
+class PeriodicTimer : public sim::SoftTimer {
+  public:
+    PeriodicTimer(TimerGenerator = TCK) {}
+    void begin(callback_t cb, double period, bool start = true) {
+      callback_ = cb;
+      period_ = period;
+      if (start)
+        this->start();
+    }
+    void start() { deadline = sim::now + (uint64_t) period_; }
+    void stop()  { deadline = UINT64_MAX; }
+    void expire() override {
+      deadline += (uint64_t) period_;
+      callback_();
+    }
+  private:
+    callback_t callback_;
+    double period_ = 0;
+};
+
+class OneShotTimer : public sim::SoftTimer {
+  public:
+    OneShotTimer(TimerGenerator = TCK) {}
+    void begin(callback_t cb) { callback_ = cb; }
+    void trigger(double delay) { deadline = sim::now + (uint64_t) delay; }
+    void stop() { deadline = UINT64_MAX; }
+    void expire() override {
+      deadline = UINT64_MAX;
+      callback_();
+    }
+  private:
+    callback_t callback_;
+};
+
+}
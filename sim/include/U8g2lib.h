@@ -0,0 +1,48 @@
+#pragma once
+// Stand-in for U8g2 (env:native only). Drawing is a no-op, transferring the
+// buffer to the display costs time.
+
+#include <Arduino.h>
+
+#define U8X8_PROGMEM
+#define U8G2_R0 0
+#define U8G2_R2 2
+#define U8X8_MSG_GPIO_MENU_SELECT 80
+#define U8X8_MSG_GPIO_MENU_NEXT   81
+#define U8X8_MSG_GPIO_MENU_PREV   82
+#define U8X8_MSG_GPIO_MENU_HOME   83
+#define U8X8_MSG_GPIO_MENU_UP     84
+#define U8X8_MSG_GPIO_MENU_DOWN   85
+
+typedef uint8_t u8g2_uint_t;
+struct u8x8_t {};
+
+static const uint8_t u8g2_font_helvR08_tr[1]  = {0};
+static const uint8_t u8g2_font_helvR10_tr[1]  = {0};
+static const uint8_t u8g2_font_inb24_mn[1]    = {0};
+static const uint8_t u8g2_font_inb46_mn[1]    = {0};
+static const uint8_t u8g2_font_m2icon_9_tf[1] = {0};
+
+class U8G2 : public Print {
+  public:
+    U8G2() {}
+    void begin() {}
+    void clearBuffer() {}
+    void sendBuffer() { sim::busy(sim::SEND_BUFFER_US); }
+    void clearDisplay() { sim::busy(sim::SEND_BUFFER_US); }
+    void setContrast(uint8_t) {}
+    void setFont(const uint8_t*) {}
+    void setFontRefHeightAll() {}
+    void setFontRefHeightText() {}
+    void setCursor(u8g2_uint_t, u8g2_uint_t) {}
+    void drawStr(u8g2_uint_t, u8g2_uint_t, const char*) {}
+    void drawXBMP(u8g2_uint_t, u8g2_uint_t, u8g2_uint_t, u8g2_uint_t, const uint8_t*) {}
+    void drawBox(u8g2_uint_t, u8g2_uint_t, u8g2_uint_t, u8g2_uint_t) {}
+    void drawFrame(u8g2_uint_t, u8g2_uint_t, u8g2_uint_t, u8g2_uint_t) {}
+    void drawHLine(u8g2_uint_t, u8g2_uint_t, u8g2_uint_t) {}
+    void drawVLine(u8g2_uint_t, u8g2_uint_t, u8g2_uint_t) {}
+    u8g2_uint_t getStrWidth(const char *s) { return 6 * strlen(s); }
+    uint8_t userInterfaceMessage(const char*, const char*, const char*, const char*) { return 1; }
+    uint8_t userInterfaceSelectionList(const char*, uint8_t start, const char*) { return start; }
+    uint8_t userInterfaceInputValue(const char*, const char*, uint8_t*, uint8_t, uint8_t, uint8_t, const char*) { return 1; }
+};
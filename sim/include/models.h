@@ -0,0 +1,195 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <vector>
+#include "sim.h"
+
+namespace sim {
+
+// Simulated VS1053B
+//
+// Models the SCI registers and WRAM locations used by the firmware, the 2 KB
+// stream buffer filled via SDI and signalled by DREQ, parsing of the
+// Ogg/Vorbis headers and decoding of audio at the nominal sampling rate as
+// modified by the ppm2 value in WRAM 0x1e07 (applied by rewriting AUDATA, see
+// section 1.5 of vs1053b-patches.pdf). SCI and SDI are accessible through
+// the Adafruit_VS1053 stand-in as well as on the byte level via SPI.
+//
+// Decoded samples pass the audio buffer and the DAC before they are heard:
+// SAMPLECOUNT runs ahead of position() by the fill level of the audio buffer
+// (a sawtooth, as the decoder tops it up a block at a time, plus a slow
+// wander with the decoder's load) and the delay of the DAC.
+//
+// The track is synthesized by content(): real Ogg page headers with granule
+// positions following the average bitrate, zeros as payload. The page
+// headers in the data received via SDI tell where in the file the decoder
+// is, so that jumps to another page (seeking) are followed by position().
+class VS1053Model : public SpiDevice, public EventSource {
+  public:
+    VS1053Model();
+    // properties of the track that's being played
+    uint16_t fs          = 44100;             // sampling rate [Hz]
+    uint8_t  channels    = 2;
+    uint32_t bitrate     = 128000;            // average bitrate [bit/s]
+    uint32_t headerBytes = 4200;              // Ogg/Vorbis headers preceding the audio data
+    double   seconds     = 0;                 // duration of audio [s]
+
+    uint16_t sciRead(uint8_t addr);           // one transaction via Adafruit_VS1053
+    void sciWrite(uint8_t addr, uint16_t data);
+    void select(bool) override;               // SCI via SPI
+    uint8_t transfer(uint8_t) override;
+    void busTime(uint32_t ns) override;
+
+    void start();                             // start of file
+    void stop();                              // cancel playback
+    void sdi(const uint8_t *data, uint32_t n);  // data received via SDI (xDCS)
+    void content(uint64_t pos, uint8_t *buf, size_t n) const;  // of the Ogg file
+    bool playing() const { return started_ && !starved_; }
+    bool started() const { return started_; }  // from start() to stop()
+    bool held() const { return wram_[0x1e09] & 0x0002; }   // pause mode (playMode)
+    uint64_t cut();                           // end the file after the data fed so far
+    double position();                        // actual playback position in file [samples]
+    double speed() const;                     // current playback speed (1 = nominal)
+
+    // documented valid range of ppm2 for the current sampling rate
+    int32_t minPpm2() const;
+    int32_t maxPpm2() const;
+
+    // statistics
+    uint32_t rateUpdates = 0;                 // number of playback speed changes
+    uint32_t rateClamped = 0;                 // ... at or beyond the valid range
+    uint32_t underflows  = 0;                 // stream buffer ran dry before end of file
+    uint32_t sciBytes    = 0;                 // SCI traffic during playback
+    uint64_t sciBusNs    = 0;                 // ... and its duration [ns]
+
+  private:
+    static constexpr uint16_t STREAM_BUFFER_BYTES = 2048;
+    static constexpr uint16_t ID_HEADER_BYTES     = 58;     // first Ogg page
+    static constexpr uint16_t PAGE_BYTES          = 4096;   // audio pages
+    static constexpr uint32_t HEADER_BYTES_PER_S  = 100000; // speed of header parsing
+    static constexpr uint32_t STARTUP_US          = 10000;
+    static constexpr uint32_t RESUME_US           = 2500;   // from release of pause mode to output
+    static constexpr uint16_t AUDIO_BLOCK         = 1024;   // samples decoded at a time
+    static constexpr uint16_t AUDIO_LOW           = 512;    // mean audio buffer fill before top-up
+    static constexpr uint16_t AUDIO_WANDER        = 256;    // ... varies by this with load
+    static constexpr double   AUDIO_WANDER_S      = 47;     // ... over this period [s]
+    static constexpr uint8_t  AUDIO_FILL_SPEED    = 4;      // decoding vs. playback speed
+    static constexpr uint8_t  DAC_SAMPLES         = 32;     // delay of interpolation filter and DAC
+
+    uint64_t nextEvent() override;            // DREQ
+    void handleEvent() override;
+
+    // SDI on the byte level via SPI
+    class SdiPort : public SpiDevice {
+      public:
+        SdiPort(VS1053Model &m);
+        uint8_t transfer(uint8_t b) override { m_.sdi(&b, 1); return 0xFF; }
+      private:
+        VS1053Model &m_;
+    } sdiPort_;
+
+    void update();
+    void updateDREQ();
+    uint16_t regRead(uint8_t addr);
+    void regWrite(uint8_t addr, uint16_t data);
+    double fileBytes() const { return headerBytes + seconds * bitrate / 8; }
+    uint64_t pageOffset(uint32_t seq) const;  // position of page in file
+    void parse(uint8_t b);
+    uint64_t decoding() const;                // decoder running since
+    double playedSamples() const;             // into the DAC
+    double queuedSamples() const;             // in the audio buffer
+    uint32_t counter();
+
+    uint64_t last_      = 0;
+    uint64_t tStart_    = 0;
+    uint64_t tResume_   = 0;
+    bool     started_   = false;
+    bool     starved_   = false;
+    double   fed_       = 0;                  // bytes sent via SDI
+    double   consumed_  = 0;                  // bytes consumed by the decoder
+    double   counterOffset_ = 0;              // SAMPLECOUNT minus decoded samples
+    double   skipped_   = 0;                  // file position minus bytes fed
+    std::deque<std::pair<double, double>> jumps_; // bytes fed, skipped_ from there on
+    uint8_t  page_[27];                       // page header being received
+    uint8_t  pageIdx_   = 0;
+    int32_t  ppm2_      = 0;
+    uint16_t wramAddr_  = 0;
+    uint8_t  sciIdx_    = 0;                  // byte of current SPI transaction
+    uint8_t  sciOp_     = 0;
+    uint8_t  sciAddr_   = 0;
+    uint16_t sciWord_   = 0;
+    uint16_t wram_[0x10000] = {0};
+};
+
+extern VS1053Model vs1053;
+
+
+// Simulated film projector
+//
+// Generates IMPULSE edges (one per shutter blade) with speed error, slow speed
+// drift, mechanical jitter and blade asymmetry, as well as the STARTMARK
+// signal at the end of the leader. Optionally, the projector is stopped once
+// during the reel and its speed is changed in a step. Film position is tracked as a continuous phase (in
+// impulses) and serves as ground truth for the synchronization.
+//
+// Alternatively, impulse times recorded from a real projector can be replayed
+// from the start mark on; the phase is then interpolated between them.
+class ProjectorModel : public EventSource {
+  public:
+    struct Params {
+      double   fps          = 24;
+      uint8_t  blades       = 2;
+      double   speedError   = 0.012;          // constant deviation from nominal speed
+      double   driftAmpl    = 0.005;          // amplitude of slow speed drift
+      double   driftPeriod  = 90;             // period of slow speed drift [s]
+      double   jitter       = 0.02;           // std of impulse timing (fraction of period)
+      double   asymmetry    = 0.01;           // blade asymmetry (fraction of period)
+      double   motorOn      = 0.5;            // start of projector motor [s]
+      double   tauUp        = 0.4;            // time constant of spin-up [s]
+      double   tauDown      = 0.3;            // time constant of spin-down [s]
+      double   leaderFrames = 60;             // frames of leader after motor start
+      double   pauseAt      = 0;              // stop projector at [s] (0 = never)
+      double   pauseSecs    = 5;              // duration of stop [s]
+      double   stepAt       = 0;              // change speed at [s] (0 = never)
+      double   stepSize     = 0;              // ... by (fraction of speed)
+      uint32_t seed         = 1;
+    };
+
+    void begin(const Params&);
+    uint64_t nextEvent() override;
+    void handleEvent() override;
+
+    double phase(uint64_t t);                 // film position at t [impulses]
+    double phaseAtStartmark() const { return leaderImps_; }
+    double speed(double t) const;             // instantaneous speed [impulses/s]
+
+    void replay(const std::vector<uint32_t>&); // impulses from now on [us, relative]
+    bool record = false;                      // keep times of generated impulses
+    std::vector<uint64_t> impulses;           // ... here
+    uint64_t startmark() const { return tStartmark_; }
+
+  private:
+    static constexpr uint32_t GRID_US = 1000;
+    void extendGrid(uint64_t t);
+    double envelope(double t) const;
+    uint64_t crossing(double phase);         // time at which phase is reached
+    void scheduleImpulse();
+
+    Params p_;
+    std::mt19937 rng_;
+    std::deque<double> grid_;                 // phase on a 1 ms grid
+    uint64_t gridStart_ = 0;                  // time of grid_.front()
+    double leaderImps_ = 0;
+    bool startmarkPending_ = false;
+    uint64_t tStartmark_ = UINT64_MAX;
+    uint64_t tImpulse_ = UINT64_MAX;
+    uint32_t nImpulse_ = 0;                   // index of next impulse
+    std::vector<uint32_t> replay_;
+    uint64_t replayStart_ = UINT64_MAX;
+};
+
+extern ProjectorModel projectorModel;
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+class SPIClass;
+
+// Core of the host-side simulation (env:native).
+//
+// Simulated time is kept in microseconds and only advances when the firmware
+// is busy (SPI transactions, display updates, ...) or calls yield()/delay().
+// Interrupt sources (projector, metric sampler) fire at their exact event
+// times while time advances, TCK software timers only fire from within
+// yield() - just like on the Teensy.
+
+namespace sim {
+
+extern uint64_t now;                          // simulated time [µs]
+extern uint64_t isrMicros;                    // time spent in interrupt handlers [µs]
+
+// something that triggers at well defined points in time (e.g., an edge on
+// one of the projector's sensor lines)
+class EventSource {
+  public:
+    EventSource();
+    virtual ~EventSource();
+    virtual uint64_t nextEvent() = 0;         // time of next event [µs], UINT64_MAX if none
+    virtual void handleEvent() = 0;           // called with sim::now set to nextEvent()
+  private:
+    EventSource* next_;
+    friend void advance(uint64_t);
+    friend uint64_t nextEventTime();
+};
+
+// a TCK software timer (see TeensyTimerTool.h)
+class SoftTimer {
+  public:
+    SoftTimer();
+    virtual ~SoftTimer();
+    uint64_t deadline = UINT64_MAX;           // next expiry [µs], UINT64_MAX if stopped
+    virtual void expire() = 0;
+  private:
+    SoftTimer* next_;
+    friend void tick();
+    friend uint64_t nextEventTime();
+};
+
+void advance(uint64_t until);                 // advance time, fire interrupts on the way
+void busy(uint32_t us);                       // CPU is busy for the given period
+void tick();                                  // fire expired TCK timers
+uint64_t nextEventTime();                     // earliest pending event or timer expiry
+void step();                                  // one iteration of yield()
+
+// a device on the SPI bus, selected by its chip select pin (see SPI.h)
+class SpiDevice {
+  public:
+    SpiDevice(uint8_t cs);
+    virtual void select(bool) {}              // chip select asserted/released
+    virtual uint8_t transfer(uint8_t) = 0;
+    virtual void busTime(uint32_t) {}         // duration of last transfer [ns]
+  private:
+    uint8_t cs_;
+    SpiDevice* next_;
+    friend class ::SPIClass;
+    friend void pinWritten(uint8_t, bool);
+};
+
+// serial port (see HardwareSerial in Arduino.h)
+extern std::string serialOut;                 // everything sent on Serial1
+
+// pins & interrupts
+void pinWritten(uint8_t pin, bool level);     // an output pin has been written
+void setPin(uint8_t pin, bool level);         // drive an input pin (calls attached ISRs)
+bool getPin(uint8_t pin);
+bool inInterrupt();                           // an interrupt handler is running
+void maskPin(uint8_t pin, bool mask);         // defer the pin's ISR (SPI.usingInterrupt)
+
+// cost of a single SCI transaction with the VS1053B: 32 bits at 250 kHz
+// (VS1053_CONTROL_SPI_SETTING of the Adafruit library) plus some overhead
+constexpr uint32_t SCI_TRANSACTION_US = 140;
+
+// SDI (Adafruit's VS1053_DATA_SPI_SETTING): 8 MHz plus some overhead per call
+constexpr uint32_t SDI_MHZ = 8;
+constexpr uint32_t SDI_OVERHEAD_US = 8;
+
+// setting up a DMA transfer
+constexpr uint32_t DMA_SETUP_US = 2;
+
+// cost of transferring the display buffer (1 KB at 8 MHz plus overhead)
+constexpr uint32_t SEND_BUFFER_US = 1500;
+
+// upper bound for a single step of yield() when there's nothing to do
+constexpr uint32_t MAX_IDLE_US = 1000;
+
+// minimum time spent per iteration of a busy loop calling yield()
+constexpr uint32_t LOOP_US = 10;
+
+}
@@ -0,0 +1,462 @@
+// Closed-loop sync benchmark (env:native)
+//
+// Plays a simulated reel for each combination of frame rate, sampling rate
+// and number of shutter blades through the unmodified Audio::selectTrack()
+// state machine and reports how well the audio follows the film:
+//
+//   lock  time from start of playback until the offset stays within
+//         +/-LOCK_FRAMES for at least LOCK_SECS [s]
+//   max   maximum absolute offset after lock [frames]
+//   rms   RMS of offset after lock [frames]
+//   clamp share of playback speed updates at the limits of the valid range [%]
+//   uflow number of stream buffer underflows during playback
+//   sci   SCI bus time per PID tick during playback [us]
+//   isr   share of CPU time spent in interrupt handlers, e.g., feeding SDI [%]
+//   jit   RMS deviation of the PID tick period from nominal [us]
+//
+// Each combination is run with both filters for the sync error (moving
+// average and tracker) unless selected otherwise.
+//
+// Each combination runs in a child process of its own, so that every run
+// starts from a freshly booted firmware.
+//
+// The SD card holds the SPI bus for every sector read and can be made to
+// stall for a few hundred milliseconds now and then (-l), like real cards do
+// when walking the FAT or levelling wear.
+//
+// Playback can be started mid-reel (-c): the firmware is told the frame that
+// follows the start mark and seeks to it in the track.
+//
+// Impulses generated by the projector model can be written to a file (-w) in
+// the format read by ImpulseReplay. Such a file - or one recorded from a real
+// projector - can be replayed instead of the simulated impulses (-i).
+//
+// The session log written by the firmware (built with -D SESSION_LOG) can be
+// copied from the simulated SD card to a file (-g), e.g., for tools/synclog.py.
+// Likewise, the telemetry sent on the serial port (built with -D TELEMETRY)
+// can be written to a file (-e) for tools/telemetry.py.
+//
+// The PID gains of the projector profile can be set (-p) or auto-tuned at the
+// start of playback (-a), as from the projector menu. The tuned gains are
+// reported and used for the rest of the reel, so the results show how well
+// they do (lock time includes the tuning).
+//
+// With -o, a real Ogg file is scanned instead (see oggbench.cpp).
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <getopt.h>
+#include <fstream>
+#include <iterator>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "audio.h"
+#include "impulse.h"
+#include "buzzer.h"
+#include "pins.h"
+#include "projector.h"
+#include "ui.h"
+#include "models.h"
+#include <DMAChannel.h>
+
+#define LOCK_FRAMES      0.5
+#define LOCK_SECS        5.0
+#define SAMPLE_PERIOD_US 10000
+
+int oggBench(const char *path);                         // oggbench.cpp
+
+// the firmware's global objects (see main.cpp)
+Audio musicPlayer;
+U8G2* u8g2 = new U8G2();
+RotaryEncoder enc;
+Buzzer buzzer(PIN_BUZZER);
+Projector projector;
+UI ui;
+
+struct Options {
+  double minutes = 120;
+  std::vector<double>   fps    = {16, 18, 24};
+  std::vector<uint16_t> fs     = {22050, 32000, 44100, 48000};
+  std::vector<uint8_t>  blades = {2, 3};
+  std::vector<uint8_t>  filter = {FILTER_AVERAGE, FILTER_TRACKER};
+  uint32_t seed = 1;
+  bool pause = true;
+  double step = 0;                                      // speed step [%]
+  uint32_t spike = 0;                                   // SD card latency spikes [ms]
+  double cue = 0;                                       // start of playback in reel [s]
+  const char *trace = nullptr;                          // prefix for CSV traces
+  const char *write = nullptr;                          // prefix for impulse files
+  const char *log = nullptr;                            // prefix for session logs
+  const char *telemetry = nullptr;                      // prefix for serial output
+  std::vector<double> gains;                            // P, I, D of the projector profile
+  bool tune = false;                                    // auto-tune the gains
+  std::string replay;                                   // content of impulse file
+};
+
+struct Result {
+  double lock = -1, max = 0, rms = 0, clamp = 0;
+  uint32_t underflows = 0;
+  double sci = 0;
+  double isr = 0;
+  double jitter = 0;
+  uint32_t collisions = 0;
+  bool tuned = false;
+  float ku = 0, tu = 0;
+  uint16_t p = 0, i = 0, d = 0;                        // hundredths
+};
+
+// samples the true offset between audio and film
+class Recorder : public sim::EventSource {
+  public:
+    Recorder(const char *filename, double fps, uint16_t fs, uint8_t blades, double n0, uint32_t frame0, uint64_t timeout)
+      : filename_(filename), fps_(fps), fs_(fs), blades_(blades), n0_(n0), frame0_(frame0), timeout_(timeout) {}
+    uint64_t nextEvent() override { return next_; }
+    void handleEvent() override {
+      next_ += SAMPLE_PERIOD_US;
+      if (sim::now > timeout_) {                        // end of reel: cut the track
+        if (auto f = sim::sdFind(filename_))
+          f->size = std::min(f->size, sim::vs1053.cut());
+        return;
+      }
+      if (!offsets.empty() && !sim::vs1053.started())   // played out, the track is being indexed
+        return;
+      double film = (sim::projectorModel.phase(sim::now) - n0_) / blades_;
+      if (film < 0)
+        return;
+      film += frame0_;
+      double audio = sim::vs1053.position() * fps_ / fs_;
+      offsets.push_back(audio - film);
+    }
+    std::vector<double> offsets;                        // audio - film [frames]
+  private:
+    const char *filename_;
+    double fps_;
+    uint16_t fs_;
+    uint8_t blades_;
+    double n0_;
+    uint32_t frame0_;
+    uint64_t timeout_;
+    uint64_t next_ = 0;
+};
+
+// replays impulses and makes the projector model follow them
+class Replay : public ImpulseReplay {
+  public:
+    Replay(const std::string &data) : ImpulseReplay("impulses.bin") {
+      for (size_t i = 0; i + 4 <= data.size(); i += 4) {
+        const uint8_t *b = (const uint8_t*) &data[i];
+        times_.push_back(b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t) b[3] << 24));
+      }
+    }
+    void begin() override {
+      ImpulseReplay::begin();
+      started_ = false;
+    }
+    void poll() override {
+      if (!started_ && !sim::getPin(STARTMARK) && !times_.empty()) {  // as ImpulseReplay
+        sim::projectorModel.replay(times_);
+        started_ = true;
+      }
+      ImpulseReplay::poll();
+    }
+  private:
+    std::vector<uint32_t> times_;
+    bool started_ = false;
+};
+
+static Result evaluate(const std::vector<double> &offsets) {
+  Result r;
+  const size_t nLock = LOCK_SECS * 1E6 / SAMPLE_PERIOD_US;
+  size_t inBand = 0, iLock = SIZE_MAX;
+  for (size_t i = 0; i < offsets.size() && iLock == SIZE_MAX; i++) {
+    inBand = (std::fabs(offsets[i]) < LOCK_FRAMES) ? inBand + 1 : 0;
+    if (inBand >= nLock)
+      iLock = i + 1 - inBand;
+  }
+  if (iLock == SIZE_MAX)
+    iLock = 0;
+  else
+    r.lock = iLock * SAMPLE_PERIOD_US / 1E6;
+  double sum = 0;
+  for (size_t i = iLock; i < offsets.size(); i++) {
+    r.max = std::max(r.max, std::fabs(offsets[i]));
+    sum += offsets[i] * offsets[i];
+  }
+  if (offsets.size() > iLock)
+    r.rms = std::sqrt(sum / (offsets.size() - iLock));
+  return r;
+}
+
+static Result run(const Options &o, double fps, uint16_t fs, uint8_t blades, uint8_t filter) {
+  double seconds = o.minutes * 60;
+
+  // projector profile
+  EEPROMstruct cfg;
+  cfg.shutterBladeCount = blades;
+  cfg.filter = filter;
+  if (o.gains.size() == 3) {
+    uint16_t g[3];                                      // hundredths, as stored
+    for (int k = 0; k < 3; k++)
+      g[k] = (uint16_t) std::lround(std::min(std::max(o.gains[k], 0.0), 99.99) * 100);
+    cfg.p = g[0] / 100; cfg.pFrac = g[0] % 100;
+    cfg.i = g[1] / 100; cfg.iFrac = g[1] % 100;
+    cfg.d = g[2] / 100; cfg.dFrac = g[2] % 100;
+  }
+  strcpy(cfg.name, "Simulator");
+  EEPROM.write(EEPROM_IDX_COUNT, 1);
+  EEPROM.write(EEPROM_IDX_LAST, 1);
+  EEPROM.write(EEPROM_IDX_VERSION, EEPROM_VERSION);
+  projector.e2save(1, cfg);
+  projector.loadLast();
+
+  // SD card & track, e.g., "999-16.667.ogg" for 16 2/3 fps
+  char name[16], filename[24];                           // any %g, not just FPS_NAME_LENGTH
+  snprintf(name, sizeof(name), "%g", fps);
+  snprintf(filename, sizeof(filename), "999-%s.ogg", name);
+  frameRate rate;
+  if (TrackDirectory::rate(name, &rate))
+    fps = (double) rate.num / rate.den;                   // the rate the firmware plays at
+  sim::vs1053.fs = fs;
+  sim::vs1053.seconds = seconds;
+  sim::sdAddFile(filename, "", sim::vs1053.headerBytes + seconds * sim::vs1053.bitrate / 8);
+  sim::sdFind(filename)->content = [](uint64_t pos, uint8_t *buf, size_t n) { sim::vs1053.content(pos, buf, n); };
+  sim::sdLatency.spikeUs = o.spike * 1000;
+  sim::sdLatency.rng.seed(o.seed);
+  sim::setPin(VS1053_SDCD, HIGH);                         // card inserted
+  sim::setPin(ENC_A, HIGH);                               // knob at rest, button released
+  sim::setPin(ENC_B, HIGH);
+  sim::setPin(ENC_BTN, HIGH);
+  enc.begin(ENC_A, ENC_B, ENC_BTN);
+  musicPlayer.begin();
+  musicPlayer.loadTrack(999);
+  if (o.cue)                                              // seeked before: indexed
+    musicPlayer.indexTrack();
+
+  // projector
+  sim::ProjectorModel::Params p;
+  p.fps = fps;
+  p.blades = blades;
+  p.seed = o.seed;
+  p.pauseAt = (o.pause) ? seconds * 0.4 : 0;
+  p.stepAt = (o.step) ? seconds * 0.7 : 0;
+  p.stepSize = o.step / 100;
+  sim::projectorModel.begin(p);
+  sim::projectorModel.record = o.write != nullptr;
+  Replay replay(o.replay);
+  if (!o.replay.empty()) {
+    sim::sdAddFile("impulses.bin", o.replay);
+    musicPlayer.setImpulseSource(&replay);
+  }
+
+  // n0: the impulse that playback is started on
+  double n0 = std::floor(sim::projectorModel.phaseAtStartmark()) + cfg.startmarkOffset * blades;
+  uint32_t frame0 = std::lround(o.cue * fps);
+  Recorder rec(filename, fps, fs, blades, n0, frame0, sim::now + (seconds - o.cue + 60) * 1E6);
+
+  musicPlayer.setStartFrame(frame0);
+  musicPlayer.selectTrack(o.tune);
+
+  if (o.trace) {
+    char fn[256];
+    snprintf(fn, sizeof(fn), "%s-%g-%u-%u-%u.csv", o.trace, fps, fs, blades, filter);
+    if (FILE *f = fopen(fn, "w")) {
+      fprintf(f, "time,offset\n");
+      for (size_t i = 0; i < rec.offsets.size(); i++)
+        fprintf(f, "%.2f,%.4f\n", i * SAMPLE_PERIOD_US / 1E6, rec.offsets[i]);
+      fclose(f);
+    }
+  }
+
+  if (o.write) {
+    char fn[256];
+    snprintf(fn, sizeof(fn), "%s-%g-%u.bin", o.write, fps, blades);
+    if (FILE *f = fopen(fn, "wb")) {
+      for (uint64_t t : sim::projectorModel.impulses) {
+        if (t < sim::projectorModel.startmark())
+          continue;
+        uint8_t b[4] = {(uint8_t) t, (uint8_t) (t >> 8), (uint8_t) (t >> 16), (uint8_t) (t >> 24)};
+        fwrite(b, 1, 4, f);
+      }
+      fclose(f);
+    }
+  }
+
+  if (o.log) {
+    char fn[256];
+    std::string log(filename);
+    log.replace(log.rfind('.'), std::string::npos, ".log");
+    snprintf(fn, sizeof(fn), "%s-%g-%u-%u-%u.log", o.log, fps, fs, blades, filter);
+    auto f = sim::sdFind(log.c_str());
+    std::ofstream out(fn, std::ios::binary);
+    if (f)
+      out.write(f->data.data(), f->data.size());
+    else
+      fprintf(stderr, "no session log (build with -D SESSION_LOG)\n");
+  }
+
+  if (o.telemetry) {
+    char fn[256];
+    snprintf(fn, sizeof(fn), "%s-%g-%u-%u-%u.bin", o.telemetry, fps, fs, blades, filter);
+    std::ofstream(fn, std::ios::binary) << sim::serialOut;
+    if (sim::serialOut.empty())
+      fprintf(stderr, "no telemetry (build with -D TELEMETRY)\n");
+  }
+
+  Result r = evaluate(rec.offsets);
+  r.clamp = 100.0 * sim::vs1053.rateClamped / std::max(1U, sim::vs1053.rateUpdates);
+  r.underflows = sim::vs1053.underflows;
+  r.sci = sim::vs1053.sciBusNs / 1E3 / std::max(1U, sim::vs1053.rateUpdates);
+  r.isr = 100.0 * sim::isrMicros / std::max<uint64_t>(1, sim::now);
+  r.jitter = musicPlayer.tickJitter().rms();
+
+  const AutoTune &t = musicPlayer.autoTune();
+  r.tuned = t.done();
+  r.ku = t.ku;
+  r.tu = t.tu;
+  r.p = t.p;
+  r.i = t.i;
+  r.d = t.d;
+
+  // SDI via DMA (-D SDI_DMA): nothing else may use the bus during a transfer
+  r.collisions = sim::spiCollisions;
+  for (size_t i = 1; i < sim::dmaLog.size(); i++)
+    if (sim::dmaLog[i].start < sim::dmaLog[i - 1].end || sim::dmaLog[i].bytes > 32)
+      r.collisions++;
+  return r;
+}
+
+static std::vector<double> parseList(const char *s) {
+  std::vector<double> out;
+  for (char *end; *s; s = (*end) ? end + 1 : end)
+    out.push_back(strtod(s, &end));
+  return out;
+}
+
+int main(int argc, char *argv[]) {
+  Options o;
+  static const option longOpts[] = {
+    {"minutes", required_argument, nullptr, 'm'},
+    {"fps",     required_argument, nullptr, 'f'},
+    {"fs",      required_argument, nullptr, 's'},
+    {"blades",  required_argument, nullptr, 'b'},
+    {"filter",  required_argument, nullptr, 'k'},
+    {"seed",    required_argument, nullptr, 'r'},
+    {"nopause", no_argument,       nullptr, 'n'},
+    {"step",    required_argument, nullptr, 'j'},
+    {"latency", required_argument, nullptr, 'l'},
+    {"cue",     required_argument, nullptr, 'c'},
+    {"trace",   required_argument, nullptr, 't'},
+    {"write",   required_argument, nullptr, 'w'},
+    {"impulses", required_argument, nullptr, 'i'},
+    {"log",     required_argument, nullptr, 'g'},
+    {"telemetry", required_argument, nullptr, 'e'},
+    {"gains",   required_argument, nullptr, 'p'},
+    {"tune",    no_argument,       nullptr, 'a'},
+    {"ogg",     required_argument, nullptr, 'o'},
+    {nullptr, 0, nullptr, 0}};
+  for (int c; (c = getopt_long(argc, argv, "m:f:s:b:k:r:nj:l:c:t:w:i:g:e:p:ao:", longOpts, nullptr)) != -1;) {
+    switch (c) {
+      case 'm': o.minutes = atof(optarg); break;
+      case 'f': o.fps = parseList(optarg); break;
+      case 's': o.fs.clear(); for (double v : parseList(optarg)) o.fs.push_back(v); break;
+      case 'b': o.blades.clear(); for (double v : parseList(optarg)) o.blades.push_back(v); break;
+      case 'k': o.filter.clear(); for (double v : parseList(optarg)) o.filter.push_back(v); break;
+      case 'r': o.seed = atoi(optarg); break;
+      case 'n': o.pause = false; break;
+      case 'j': o.step = atof(optarg); break;
+      case 'l': o.spike = atoi(optarg); break;
+      case 'c': o.cue = atof(optarg); break;
+      case 't': o.trace = optarg; break;
+      case 'w': o.write = optarg; break;
+      case 'g': o.log = optarg; break;
+      case 'e': o.telemetry = optarg; break;
+      case 'p': o.gains = parseList(optarg); break;
+      case 'a': o.tune = true; break;
+      case 'o': return oggBench(optarg);
+      case 'i': {
+        std::ifstream f(optarg, std::ios::binary);
+        o.replay.assign(std::istreambuf_iterator<char>(f), {});
+        if (o.replay.size() < 8) {
+          fprintf(stderr, "%s: no impulses in %s\n", argv[0], optarg);
+          return 1;
+        }
+        break;
+      }
+      default:
+        fprintf(stderr, "usage: %s [-m minutes] [-f fps,...] [-s fs,...] [-b blades,...] [-k filter,...] [-r seed] [-n] [-j percent] [-l ms] [-c seconds] [-t prefix] [-w prefix] [-i file] [-g prefix] [-e prefix] [-p P,I,D] [-a] [-o file.ogg]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  if (!o.replay.empty())
+    printf("Simulating %.0f min reels, replaying %zu impulses\n", o.minutes, o.replay.size() / 4);
+  else
+    printf("Simulating %.0f min reels%s%s (seed %u)\n", o.minutes, (o.pause) ? " with one stop" : "",
+           (o.step) ? " and a speed step" : "", o.seed);
+  if (o.cue)
+    printf("Playback started %.0f s into the reel\n", o.cue);
+  if (o.gains.size() == 3)
+    printf("PID gains %g/%g/%g\n", o.gains[0], o.gains[1], o.gains[2]);
+  if (o.tune)
+    printf("PID gains auto-tuned at the start of playback\n");
+  if (o.spike)
+    printf("SD card latency spikes of %u ms every %u sectors on average\n", o.spike, sim::sdLatency.spikeEvery);
+  printf("\n");
+  printf("  fps     fs  blades  filter |  lock[s]  max[fr]  rms[fr] | clamp[%%]  uflow  sci[us]  isr[%%]  jit[us]\n");
+  printf("-----------------------------+----------------------------+------------------------------------------\n");
+  fflush(stdout);
+
+  // run combinations in parallel child processes, print results in order
+  struct Job { double fps; uint16_t fs; uint8_t blades, filter; pid_t pid; int fd; };
+  std::vector<Job> jobs;
+  for (double fps : o.fps)
+    for (uint16_t fs : o.fs)
+      for (uint8_t blades : o.blades)
+        for (uint8_t filter : o.filter)
+          jobs.push_back({fps, fs, blades, filter, 0, -1});
+
+  long nParallel = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+  for (size_t first = 0; first < jobs.size(); first += nParallel) {
+    size_t last = std::min(jobs.size(), first + nParallel);
+    for (size_t i = first; i < last; i++) {
+      int fd[2];
+      if (pipe(fd))
+        return 1;
+      jobs[i].pid = fork();
+      if (jobs[i].pid == 0) {
+        close(fd[0]);
+        Result r = run(o, jobs[i].fps, jobs[i].fs, jobs[i].blades, jobs[i].filter);
+        if (write(fd[1], &r, sizeof(r)) != sizeof(r))
+          _exit(1);
+        _exit(0);
+      }
+      close(fd[1]);
+      jobs[i].fd = fd[0];
+    }
+    for (size_t i = first; i < last; i++) {
+      Result r;
+      bool ok = read(jobs[i].fd, &r, sizeof(r)) == sizeof(r);
+      close(jobs[i].fd);
+      waitpid(jobs[i].pid, nullptr, 0);
+      printf("%5.2f  %5u  %6u  %6s | ", jobs[i].fps, jobs[i].fs, jobs[i].blades,
+             (jobs[i].filter == FILTER_TRACKER) ? "track" : "avg");
+      if (!ok)
+        printf("  simulation failed\n");
+      else if (r.lock < 0)
+        printf("      -  %7.2f  %7.2f | %8.2f  %5u  %7.0f  %6.2f  %7.0f\n", r.max, r.rms, r.clamp, r.underflows, r.sci, r.isr, r.jitter);
+      else
+        printf("%7.1f  %7.2f  %7.2f | %8.2f  %5u  %7.0f  %6.2f  %7.0f\n", r.lock, r.max, r.rms, r.clamp, r.underflows, r.sci, r.isr, r.jitter);
+      if (ok && o.tune && r.tuned)
+        printf("      auto-tune: Ku %.1f ppm2/sample, Tu %.2f s -> P %.2f, I %.2f, D %.2f\n",
+               r.ku, r.tu, r.p / 100.0, r.i / 100.0, r.d / 100.0);
+      else if (ok && o.tune)
+        printf("      auto-tune failed\n");
+      if (ok && r.collisions)
+        printf("      %u SPI bus collisions with SDI DMA transfers!\n", r.collisions);
+      fflush(stdout);
+    }
+  }
+  return 0;
+}
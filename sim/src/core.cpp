@@ -0,0 +1,375 @@
+// Simulated time, pins, interrupts and TCK timers (env:native)
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <SD.h>
+#include <SPI.h>
+#include <DMAChannel.h>
+#include <random>
+#include <vector>
+
+namespace sim {
+
+uint64_t now = 0;
+uint64_t isrMicros = 0;
+static uint8_t isrDepth = 0;
+
+static EventSource* sources = nullptr;
+static SoftTimer* timers = nullptr;
+
+EventSource::EventSource() : next_(sources) { sources = this; }
+
+EventSource::~EventSource() {
+  for (EventSource** p = &sources; *p; p = &(*p)->next_)
+    if (*p == this) {
+      *p = next_;
+      break;
+    }
+}
+
+SoftTimer::SoftTimer() : next_(timers) { timers = this; }
+
+SoftTimer::~SoftTimer() {
+  for (SoftTimer** p = &timers; *p; p = &(*p)->next_)
+    if (*p == this) {
+      *p = next_;
+      break;
+    }
+}
+
+void advance(uint64_t until) {
+  while (true) {
+    EventSource* src = nullptr;
+    uint64_t t = until;
+    for (EventSource* s = sources; s; s = s->next_) {
+      uint64_t ts = s->nextEvent();
+      if (ts <= t) {
+        t = ts;
+        src = s;
+      }
+    }
+    if (!src)
+      break;
+    now = std::max(now, t);
+    src->handleEvent();
+  }
+  now = std::max(now, until);
+}
+
+void busy(uint32_t us) {
+  if (isrDepth == 1)                          // nested handlers are included
+    isrMicros += us;
+  advance(now + us);
+}
+
+void tick() {
+  for (SoftTimer* s = timers; s; s = s->next_)
+    if (s->deadline <= now)
+      s->expire();
+}
+
+uint64_t nextEventTime() {
+  uint64_t t = UINT64_MAX;
+  for (EventSource* s = sources; s; s = s->next_)
+    t = std::min(t, s->nextEvent());
+  for (SoftTimer* s = timers; s; s = s->next_)
+    t = std::min(t, s->deadline);
+  return t;
+}
+
+void step() {
+  uint64_t t = std::min(nextEventTime(), now + MAX_IDLE_US);
+  advance(std::max(t, now + LOOP_US));
+  tick();
+}
+
+// pins & interrupts
+static bool level[64];
+static void (*isr[64])(void);
+static int isrMode[64];
+static bool masked[64], active[64], pending[64];
+
+// like the NVIC: an interrupt that is masked or already being served stays
+// pending and is served as soon as possible
+static void raise(uint8_t pin) {
+  if (masked[pin] || active[pin]) {
+    pending[pin] = true;
+    return;
+  }
+  active[pin] = true;
+  isrDepth++;
+  do {
+    pending[pin] = false;
+    isr[pin]();
+  } while (pending[pin] && !masked[pin] && isr[pin]);
+  isrDepth--;
+  active[pin] = false;
+}
+
+void setPin(uint8_t pin, bool val) {
+  bool prev = level[pin];
+  level[pin] = val;
+  if (!isr[pin] || prev == val)
+    return;
+  if (isrMode[pin] == CHANGE || (isrMode[pin] == RISING && val) || (isrMode[pin] == FALLING && !val))
+    raise(pin);
+}
+
+void maskPin(uint8_t pin, bool mask) {
+  masked[pin] = mask;
+  if (!mask && pending[pin] && isr[pin] && !active[pin])
+    raise(pin);
+}
+
+bool getPin(uint8_t pin) {
+  return level[pin];
+}
+
+bool inInterrupt() {
+  return isrDepth > 0;
+}
+
+// SPI devices
+static SpiDevice* devices = nullptr;
+
+SpiDevice::SpiDevice(uint8_t cs) : cs_(cs), next_(devices) { devices = this; }
+
+void pinWritten(uint8_t pin, bool val) {
+  if (level[pin] == val)
+    return;
+  level[pin] = val;
+  for (SpiDevice* d = devices; d; d = d->next_)
+    if (d->cs_ == pin)
+      d->select(!val);
+}
+
+// files
+static std::vector<std::pair<std::string, std::shared_ptr<SdFile>>> files;
+SdLatency sdLatency;
+static uint32_t modified = 0;
+
+void sdAddFile(const char *name, const std::string &data, uint64_t size) {
+  auto f = std::make_shared<SdFile>();
+  f->data = data;
+  f->size = std::max<uint64_t>(size, data.size());
+  f->modified = modified += 2;                // files (re)added later look newer (FAT: 2 s)
+  sdRemove(name);
+  files.emplace_back(name, f);
+}
+
+bool sdRemove(const char *name) {
+  for (auto f = files.begin(); f != files.end(); f++)
+    if (f->first == name) {
+      files.erase(f);
+      return true;
+    }
+  return false;
+}
+
+const char *sdName(size_t i) {
+  return (i < files.size()) ? files[i].first.c_str() : nullptr;
+}
+
+std::shared_ptr<SdFile> sdFind(const char *name) {
+  if (*name == '/')
+    name++;
+  for (auto &f : files)
+    if (f.first == name)
+      return f.second;
+  return nullptr;
+}
+
+}
+
+// Arduino API
+uint32_t micros() { return sim::now; }
+uint32_t millis() { return sim::now / 1000; }
+void yield() { sim::step(); }
+
+void delay(uint32_t ms) {
+  uint64_t until = sim::now + ms * 1000ULL;
+  while (sim::now < until) {
+    sim::advance(std::min(until, std::max(sim::nextEventTime(), sim::now + sim::LOOP_US)));
+    sim::tick();
+  }
+}
+
+void delayMicroseconds(uint32_t us) { sim::busy(us); }
+
+// serial port: 10 bits per byte (8N1)
+#define SERIAL_FIFO 64
+HardwareSerial Serial1;
+std::string sim::serialOut;
+
+int HardwareSerial::availableForWrite() {
+  if (!baud_)
+    return 0;
+  uint64_t queued = (idleAt_ > sim::now) ? ((idleAt_ - sim::now) * baud_ / 10 + 999999) / 1000000 : 0;
+  return SERIAL_FIFO - std::min<uint64_t>(queued, SERIAL_FIFO);
+}
+
+size_t HardwareSerial::write(uint8_t b) {
+  if (!baud_)
+    return 0;
+  while (!availableForWrite())
+    sim::busy(10000000 / baud_);
+  idleAt_ = std::max(idleAt_, sim::now) + 10000000 / baud_;
+  sim::serialOut += (char) b;
+  return 1;
+}
+
+void pinMode(uint8_t, uint8_t) {}
+bool digitalRead(uint8_t pin) { return sim::getPin(pin); }
+void digitalWrite(uint8_t pin, uint8_t val) { sim::pinWritten(pin, val); }
+
+void attachInterrupt(uint8_t pin, void (*fn)(void), int mode) {
+  sim::isr[pin] = fn;
+  sim::isrMode[pin] = mode;
+}
+
+void detachInterrupt(uint8_t pin) {
+  sim::isr[pin] = nullptr;
+  sim::pending[pin] = false;
+}
+
+static std::mt19937 rng;
+long random(long max) { return (max > 0) ? rng() % max : 0; }
+long random(long min, long max) { return min + random(max - min); }
+void tone(uint8_t, uint16_t, uint32_t) {}
+void noTone(uint8_t) {}
+
+// Reading a sector that isn't cached holds the SPI bus for sdLatency.sectorUs.
+// Occasionally, a latency spike follows (FAT chain walk, wear levelling, ...)
+// during which the card is polled in short transactions.
+void File::access(uint64_t from, uint64_t to) {
+  for (uint64_t sector = from / 512; sector <= (to - 1) / 512; sector++) {
+    if (sector == sector_)
+      continue;
+    sector_ = sector;
+    sim::sdLatency.sectors++;
+    SPI.beginTransaction(SPISettings());
+    sim::busy(sim::sdLatency.sectorUs);
+    SPI.endTransaction();
+    if (!sim::sdLatency.spikeUs || sim::sdLatency.rng() % sim::sdLatency.spikeEvery)
+      continue;
+    sim::sdLatency.spikes++;
+    for (uint32_t t = 0; t < sim::sdLatency.spikeUs; t += 1000) {
+      SPI.beginTransaction(SPISettings());
+      sim::busy(std::min<uint32_t>(1000, sim::sdLatency.spikeUs - t));
+      SPI.endTransaction();
+      sim::busy(sim::LOOP_US);
+    }
+  }
+}
+
+int File::read(void *buf, size_t n) {
+  if (!f_)
+    return -1;
+  sim::sdLatency.reads++;
+  n = (pos_ < f_->size) ? std::min<uint64_t>(n, f_->size - pos_) : 0;
+  if (n)
+    access(pos_, pos_ + n);
+  size_t m = (pos_ < f_->data.size()) ? std::min<size_t>(n, f_->data.size() - pos_) : 0;
+  memcpy(buf, f_->data.data() + pos_, m);
+  if (f_->content)
+    f_->content(pos_ + m, (uint8_t*) buf + m, n - m);
+  else
+    memset((uint8_t*) buf + m, 0, n - m);
+  pos_ += n;
+  return n;
+}
+
+size_t File::write(const void *buf, size_t n) {
+  if (!f_ || f_->content)
+    return 0;
+  access(pos_, pos_ + n);
+  if (f_->data.size() < pos_ + n)
+    f_->data.resize(pos_ + n);
+  memcpy(&f_->data[pos_], buf, n);
+  pos_ += n;
+  f_->size = std::max<uint64_t>(f_->size, pos_);
+  return n;
+}
+
+bool File::getModifyTime(DateTimeFields &tm) {
+  if (!f_)
+    return false;
+  uint32_t t = f_->modified;
+  tm = {(uint8_t) (t % 60), (uint8_t) (t / 60 % 60), (uint8_t) (t / 3600 % 24), 0, 1, 0, 120};
+  return true;
+}
+
+File File::openNextFile() {
+  const char *name = (dir_) ? sim::sdName(next_++) : nullptr;
+  return (name) ? File(sim::sdFind(name), name) : File();
+}
+
+File SDClass::open(const char *name, uint8_t mode) {
+  if (!strcmp(name, "/")) {                   // the root directory, flat
+    File dir;
+    dir.dir_ = true;
+    return dir;
+  }
+  if (mode == FILE_WRITE && !sim::sdFind(name))
+    sim::sdAddFile(name, "");
+  File file(sim::sdFind(name), name);
+  if (mode == FILE_WRITE)
+    file.seek(file.size());
+  return file;
+}
+
+bool FsFile::truncate() {
+  if (!f_ || f_->content)
+    return false;
+  f_->data.resize(pos_);
+  f_->size = pos_;
+  return true;
+}
+
+FsFile SdFs::open(const char *name, int oflag) {
+  if ((oflag & O_TRUNC) || ((oflag & O_CREAT) && !sim::sdFind(name)))
+    sim::sdAddFile(name, "");
+  auto f = sim::sdFind(name);
+  return (f) ? FsFile(f, name) : FsFile();
+}
+
+void SPIClass::beginTransaction(const SPISettings &settings) {
+  clock_ = settings.clock;
+  for (uint8_t pin : masks_)
+    sim::maskPin(pin, true);
+}
+
+void SPIClass::endTransaction() {
+  for (uint8_t pin : masks_)
+    sim::maskPin(pin, false);
+}
+
+uint8_t SPIClass::transfer(uint8_t b) {
+  uint32_t ns = 8000000000ULL / clock_;
+  uint8_t out = 0xFF;
+  if (sim::dmaActive)
+    sim::spiCollisions++;
+  for (sim::SpiDevice* d = sim::devices; d; d = d->next_)
+    if (!sim::level[d->cs_]) {
+      out = d->transfer(b);
+      d->busTime(ns);
+    }
+  ns_ += ns;
+  sim::busy(ns_ / 1000);
+  ns_ %= 1000;
+  return out;
+}
+
+void SPIClass::shift(const uint8_t *data, uint32_t n) {
+  uint32_t ns = 8000000000ULL / clock_;
+  for (uint32_t i = 0; i < n; i++)
+    for (sim::SpiDevice* d = sim::devices; d; d = d->next_)
+      if (!sim::level[d->cs_]) {
+        d->transfer(data[i]);
+        d->busTime(ns);
+      }
+}
+
+SDClass SD;
+SPIClass SPI;
+EEPROMClass EEPROM;
@@ -0,0 +1,50 @@
+// DMAChannel stand-in (env:native), see sim/include/DMAChannel.h
+
+#include <DMAChannel.h>
+#include <SPI.h>
+
+volatile uint8_t SPI0_DL;
+
+namespace sim {
+  std::vector<DmaTransfer> dmaLog;
+  bool dmaActive = false;
+  uint32_t spiCollisions = 0;
+}
+
+static uint8_t channels = 0;
+
+DMAChannel::DMAChannel() : channel(channels++) {}
+
+void DMAChannel::attachInterrupt(void (*isr)(void)) {
+  ::attachInterrupt(IRQ_DMA_CH0 + channel, isr, RISING);
+}
+
+void DMAChannel::enable() {
+  sim::busy(sim::DMA_SETUP_US);
+  if (trigger_ != DMAMUX_SOURCE_SPI0_TX || dst_ != &SPI0_DL || !n_)
+    return;
+  complete_ = false;
+  sim::dmaActive = true;
+  uint64_t start = sim::now;
+  end_ = start + (n_ * 8000000ULL + SPI.clock() - 1) / SPI.clock();
+  sim::dmaLog.push_back({start, end_, (uint16_t) n_});
+}
+
+void DMAChannel::handleEvent() {
+  end_ = UINT64_MAX;
+  sim::dmaActive = false;
+  SPI.shift(src_, n_);
+  complete_ = true;
+  if (irq_)
+    sim::setPin(IRQ_DMA_CH0 + channel, HIGH);
+}
+
+bool DMAChannel::complete() {
+  if (!complete_)
+    sim::busy(1);                         // polling takes time, too
+  return complete_;
+}
+
+void DMAChannel::clearInterrupt() {
+  sim::setPin(IRQ_DMA_CH0 + channel, LOW);
+}
@@ -0,0 +1,107 @@
+// Ogg scanning benchmark (env:native, -o file.ogg)
+//
+// Puts a real Ogg Vorbis file on the simulated SD card and measures what it
+// takes to get around in it:
+//
+//   naive  finding every "OggS" by comparing at each byte offset (a seek and
+//          a read per byte, as Audio::findInFile used to do)
+//   scan   ... with StreamScanner
+//   walk   visiting every page with OggWalker
+//   index  indexing the track with Audio::indexTrack()
+//
+// For each: File::read() calls, sectors read, time the simulated card held
+// the SPI bus and wall clock time on the host. Every page visited by the
+// walker has to be found by both searches.
+
+#include <Arduino.h>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <string>
+#include "audio.h"
+#include "ogg.h"
+#include "pins.h"
+
+extern Audio musicPlayer;
+
+struct Cost {
+  uint64_t reads, sectors, simUs;
+  std::chrono::steady_clock::time_point start;
+};
+
+static Cost begin() {
+  return {sim::sdLatency.reads, sim::sdLatency.sectors, sim::now, std::chrono::steady_clock::now()};
+}
+
+static void report(const char *what, const Cost &c, size_t found) {
+  double hostMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - c.start).count();
+  printf("%-6s %10zu %12llu %10llu %10.0f %10.0f\n", what, found,
+         (unsigned long long) (sim::sdLatency.reads - c.reads),
+         (unsigned long long) (sim::sdLatency.sectors - c.sectors), (sim::now - c.simUs) / 1E3, hostMs);
+  fflush(stdout);
+}
+
+int oggBench(const char *path) {
+  std::ifstream f(path, std::ios::binary);
+  std::string data(std::istreambuf_iterator<char>(f), {});
+  if (data.size() < 58) {
+    fprintf(stderr, "oggbench: can't read %s\n", path);
+    return 1;
+  }
+  const char *name = "998-24.ogg";
+  sim::sdAddFile(name, data);
+  sim::setPin(VS1053_SDCD, HIGH);                         // card inserted
+  musicPlayer.begin();
+  File file = SD.open(name);
+
+  printf("%s: %.1f MB\n\n", path, data.size() / 1E6);
+  printf("          found        reads      sectors     SD[ms]   host[ms]\n");
+  printf("---------------------------------------------------------------\n");
+
+  std::set<size_t> naive, scan, walk;
+  Cost c = begin();
+  uint8_t buf[4];
+  for (size_t i = 0; i + 4 <= file.size(); i++) {
+    file.seek(i);
+    file.read(buf, 4);
+    if (!memcmp(buf, "OggS", 4))
+      naive.insert(i);
+  }
+  report("naive", c, naive.size());
+
+  c = begin();
+  const StreamScanner capture("OggS", 4);
+  for (size_t pos = 0; (pos = capture.find(&file, pos)) != UINT32_MAX; pos++)
+    scan.insert(pos);
+  report("scan", c, scan.size());
+
+  c = begin();
+  OggWalker ogg(&file);
+  int64_t samples = 0;
+  for (bool ok = ogg.read(0); ok; ok = ogg.next()) {
+    walk.insert(ogg.position());
+    if (ogg.granulePos() > samples)
+      samples = ogg.granulePos();
+  }
+  report("walk", c, walk.size());
+
+  c = begin();
+  musicPlayer.loadTrack(998);
+  bool indexed = musicPlayer.indexTrack();
+  report("index", c, indexed);
+  file.close();
+
+  size_t missed = 0;
+  for (size_t pos : walk)
+    missed += !naive.count(pos) + !scan.count(pos);
+  printf("\n%zu pages, %lld samples", walk.size(), (long long) samples);
+  if (scan != naive)
+    printf(", scanner and naive search disagree!");
+  if (missed)
+    printf(", %zu pages not found by the searches!", missed);
+  if (!indexed)
+    printf(", indexing failed!");
+  printf("\n");
+  return (scan != naive || missed || !indexed) ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+// Simulated film projector (env:native)
+
+#include <Arduino.h>
+#include "pins.h"
+#include <algorithm>
+#include "models.h"
+
+namespace sim {
+
+ProjectorModel projectorModel;
+
+void ProjectorModel::begin(const Params &p) {
+  p_ = p;
+  rng_.seed(p.seed);
+  grid_.assign(1, 0.0);
+  gridStart_ = sim::now;
+  leaderImps_ = std::floor(p.leaderFrames * p.blades) + 0.5;
+  startmarkPending_ = true;
+  tStartmark_ = UINT64_MAX;
+  nImpulse_ = 1;
+  replay_.clear();
+  replayStart_ = UINT64_MAX;
+  impulses.clear();
+  setPin(STARTMARK, HIGH);                    // leader is threaded
+  setPin(IMPULSE, LOW);
+  scheduleImpulse();
+}
+
+double ProjectorModel::envelope(double t) const {
+  auto spinUp = [&](double t0, double e0) {
+    return 1 - (1 - e0) * std::exp(-(t - t0) / p_.tauUp);
+  };
+  if (t < p_.motorOn)
+    return 0;
+  if (p_.pauseAt <= 0 || t < p_.pauseAt)
+    return spinUp(p_.motorOn, 0);
+  double e0 = spinUp(p_.motorOn, 0);
+  double tResume = p_.pauseAt + p_.pauseSecs;
+  double eDown = e0 * std::exp(-(std::min(t, tResume) - p_.pauseAt) / p_.tauDown);
+  return (t < tResume) ? eDown : spinUp(tResume, eDown);
+}
+
+double ProjectorModel::speed(double t) const {
+  double drift = p_.driftAmpl * std::sin(2 * M_PI * t / p_.driftPeriod);
+  double step = (p_.stepAt > 0 && t >= p_.stepAt) ? p_.stepSize : 0;
+  return p_.fps * p_.blades * (1 + p_.speedError + drift + step) * envelope(t);
+}
+
+void ProjectorModel::extendGrid(uint64_t t) {
+  while (gridStart_ + (grid_.size() - 1) * GRID_US < t + GRID_US) {
+    double t0 = (gridStart_ + (grid_.size() - 1) * GRID_US) / 1E6;
+    double dt = GRID_US / 1E6;
+    grid_.push_back(grid_.back() + (speed(t0) + speed(t0 + dt)) / 2 * dt);
+  }
+}
+
+void ProjectorModel::replay(const std::vector<uint32_t> &times) {
+  replay_.clear();
+  for (uint32_t t : times)
+    replay_.push_back(t - times.front());
+  replayStart_ = sim::now;
+}
+
+double ProjectorModel::phase(uint64_t t) {
+  if (t >= replayStart_ && !replay_.empty()) {
+    // k impulses have been replayed at t
+    uint64_t dt = t - replayStart_;
+    size_t k = std::upper_bound(replay_.begin(), replay_.end(), dt) - replay_.begin();
+    double f = (k < replay_.size()) ? (double) (dt - replay_[k - 1]) / (replay_[k] - replay_[k - 1]) : 0;
+    return std::floor(leaderImps_) + k + f;
+  }
+  while (grid_.size() > 2 && gridStart_ + GRID_US < std::min(t, sim::now)) {
+    grid_.pop_front();                        // drop history
+    gridStart_ += GRID_US;
+  }
+  if (t < gridStart_)
+    return grid_.front();
+  extendGrid(t);
+  size_t i = (t - gridStart_) / GRID_US;
+  double f = (double) ((t - gridStart_) % GRID_US) / GRID_US;
+  return grid_[i] + f * (grid_[i + 1] - grid_[i]);
+}
+
+uint64_t ProjectorModel::crossing(double target) {
+  // find the grid interval in which phase crosses target
+  size_t i = (std::max(sim::now, gridStart_) - gridStart_) / GRID_US;
+  for (size_t n = 0; true; n++, i++) {
+    extendGrid(gridStart_ + (i + 1) * GRID_US);
+    if (grid_[i + 1] >= target)
+      break;
+    if (n * GRID_US > 60E6)                   // projector has stopped
+      return UINT64_MAX;
+  }
+  double f = (target - grid_[i]) / std::max(1E-12, grid_[i + 1] - grid_[i]);
+  return gridStart_ + (i + std::max(0.0, f)) * GRID_US;
+}
+
+void ProjectorModel::scheduleImpulse() {
+  uint64_t tCross = crossing(nImpulse_);
+  if (tCross == UINT64_MAX)
+    return void(tImpulse_ = UINT64_MAX);
+
+  // locate start mark
+  if (startmarkPending_ && tStartmark_ == UINT64_MAX && nImpulse_ > leaderImps_)
+    tStartmark_ = crossing(leaderImps_);
+
+  // add jitter & blade asymmetry to the crossing
+  double period = 1E6 / std::max(1.0, speed(tCross / 1E6));
+  std::normal_distribution<double> noise(0, p_.jitter);
+  double dev = std::max(-0.25, std::min(0.25, noise(rng_)));
+  dev += p_.asymmetry * ((nImpulse_ % p_.blades) - (p_.blades - 1) / 2.0);
+  tImpulse_ = std::max((double) sim::now + 1, tCross + dev * period);
+}
+
+uint64_t ProjectorModel::nextEvent() {
+  return std::min(tImpulse_, startmarkPending_ ? tStartmark_ : UINT64_MAX);
+}
+
+void ProjectorModel::handleEvent() {
+  if (startmarkPending_ && tStartmark_ <= tImpulse_) {
+    startmarkPending_ = false;
+    setPin(STARTMARK, LOW);                   // end of leader
+    return;
+  }
+  setPin(IMPULSE, HIGH);
+  setPin(IMPULSE, LOW);
+  if (record)
+    impulses.push_back(sim::now);
+  nImpulse_++;
+  scheduleImpulse();
+}
+
+}
@@ -0,0 +1,441 @@
+// Simulated VS1053B and the Adafruit_VS1053 stand-in (env:native)
+
+#include <Adafruit_VS1053.h>
+#include <SPI.h>
+#include "models.h"
+#include "pins.h"
+
+namespace sim {
+
+VS1053Model vs1053;
+
+VS1053Model::VS1053Model() : SpiDevice(VS1053_CS), sdiPort_(*this) {}
+VS1053Model::SdiPort::SdiPort(VS1053Model &m) : SpiDevice(VS1053_DCS), m_(m) {}
+
+// WRAM locations (see vs1053b-patches.pdf and the VS1053B datasheet)
+#define WRAM_SAMPLECOUNT_LSW 0x1800
+#define WRAM_SAMPLECOUNT_MSW 0x1801
+#define WRAM_PPM2_LSW        0x1e07
+#define WRAM_PPM2_MSW        0x1e08
+#define WRAM_PLAYMODE        0x1e09
+#define PLAYMODE_PAUSE_ON    0x0002
+#define WRAM_POSMSEC_LSW     0x1e27
+#define WRAM_POSMSEC_MSW     0x1e28
+#define WRAM_STREAM_WRP      0x5a7d
+#define WRAM_STREAM_RDP      0x5a7e
+#define WRAM_AUDIO_WRP       0x5a80
+#define WRAM_AUDIO_RDP       0x5a81
+#define WRAM_UNDERFLOW       0x5a82
+
+void VS1053Model::update() {
+  uint64_t t = sim::now;
+  uint64_t from = std::max(last_, decoding());
+  last_ = std::max(last_, t);
+  if (!started_ || held() || t <= from)
+    return;
+  double dt = (t - from) / 1E6;
+
+  // parse headers
+  if (consumed_ < headerBytes) {
+    double n = std::min({fed_ - consumed_, headerBytes - consumed_, dt * HEADER_BYTES_PER_S});
+    consumed_ += n;
+    dt -= n / HEADER_BYTES_PER_S;
+  }
+
+  // decode audio
+  if (consumed_ >= headerBytes && dt > 0) {
+    double want = dt * bitrate / 8 * speed();
+    double avail = fed_ - consumed_;
+    if (want > avail) {
+      if (!starved_ && consumed_ + avail + skipped_ < fileBytes())
+        underflows++;
+      starved_ = true;
+      want = avail;
+    } else
+      starved_ = false;
+    consumed_ += want;
+  }
+}
+
+void VS1053Model::updateDREQ() {
+  // DREQ is high while there's room for at least 32 bytes
+  update();
+  sim::setPin(VS1053_DREQ, !started_ || fed_ - consumed_ <= STREAM_BUFFER_BYTES - 32);
+}
+
+uint64_t VS1053Model::nextEvent() {
+  if (!started_ || held() || sim::getPin(VS1053_DREQ))
+    return UINT64_MAX;
+  double needed = fed_ - consumed_ - (STREAM_BUFFER_BYTES - 32);
+  double rate = (consumed_ < headerBytes) ? HEADER_BYTES_PER_S : bitrate / 8 * speed();
+  uint64_t t = std::max(last_, decoding()) + (uint64_t) std::ceil(std::max(0.0, needed) / rate * 1E6);
+  return std::max(t, sim::now + 1);
+}
+
+void VS1053Model::handleEvent() {
+  updateDREQ();
+}
+
+uint64_t VS1053Model::cut() {
+  update();
+  seconds = std::max(0.0, fed_ + skipped_ - headerBytes) * 8 / bitrate;
+  return fed_ + skipped_;
+}
+
+void VS1053Model::sdi(const uint8_t *data, uint32_t n) {
+  update();
+  for (uint32_t i = 0; i < n; i++) {
+    parse(data[i]);
+    fed_++;
+  }
+  updateDREQ();
+}
+
+void VS1053Model::parse(uint8_t b) {
+  // watch for page headers, their sequence number tells the position in file
+  static const char capture[] = "OggS";
+  if (pageIdx_ < 4 && b != capture[pageIdx_])
+    pageIdx_ = 0;
+  if (pageIdx_ < 4 && b != capture[pageIdx_])
+    return;
+  page_[pageIdx_++] = b;
+  if (pageIdx_ < sizeof(page_))
+    return;
+  pageIdx_ = 0;
+  uint32_t seq = page_[18] | (page_[19] << 8) | (page_[20] << 16) | ((uint32_t) page_[21] << 24);
+  double skipped = pageOffset(seq) - (fed_ + 1 - sizeof(page_));
+  if (skipped != skipped_) {
+    skipped_ = skipped;
+    jumps_.emplace_back(fed_ + 1 - sizeof(page_), skipped);
+  }
+}
+
+uint64_t VS1053Model::pageOffset(uint32_t seq) const {
+  // identification header, comment & setup headers, audio pages
+  return (seq == 0) ? 0 : (seq == 1) ? ID_HEADER_BYTES : headerBytes + (uint64_t) (seq - 2) * PAGE_BYTES;
+}
+
+void VS1053Model::content(uint64_t pos, uint8_t *buf, size_t n) const {
+  memset(buf, 0, n);
+  auto page = [&](uint64_t start, uint32_t bytes, uint32_t seq, int64_t granule,
+                  const uint8_t *payload, size_t payloadBytes) {
+    if (start >= pos + n || start + bytes <= pos)
+      return;
+    uint8_t nSegments = 1;                    // all lacing values 255 but the last
+    while ((bytes - 27 - nSegments) / 255 + 1 != nSegments)
+      nSegments++;
+    std::vector<uint8_t> p(bytes, 0);
+    memcpy(&p[0], "OggS", 4);
+    p[5] = (seq == 0) ? 0x02 : 0x00;          // beginning of stream
+    for (uint8_t i = 0; i < 8; i++)
+      p[6 + i] = (uint64_t) granule >> (8 * i);
+    p[14] = 0x53;                             // serial number
+    for (uint8_t i = 0; i < 4; i++)
+      p[18 + i] = seq >> (8 * i);
+    p[26] = nSegments;
+    memset(&p[27], 255, nSegments - 1);
+    p[27 + nSegments - 1] = (bytes - 27 - nSegments) % 255;
+    memcpy(&p[27 + nSegments], payload, std::min<size_t>(payloadBytes, bytes - 27 - nSegments));
+    for (uint64_t i = std::max(pos, start); i < std::min(pos + n, start + bytes); i++)
+      buf[i - pos] = p[i - start];
+  };
+
+  // identification header (Vorbis I specification, section 4.2.2)
+  uint8_t id[30] = {1, 'v', 'o', 'r', 'b', 'i', 's', 0, 0, 0, 0, channels};
+  for (uint8_t i = 0; i < 4; i++) {
+    id[12 + i] = fs >> (8 * i);
+    id[20 + i] = bitrate >> (8 * i);
+  }
+  id[28] = 0xB8;                              // block sizes 256 & 2048
+  id[29] = 1;                                 // framing
+  page(0, ID_HEADER_BYTES, 0, 0, id, sizeof(id));
+
+  // comment and setup headers
+  uint8_t setup[64] = {3, 'v', 'o', 'r', 'b', 'i', 's'};
+  memcpy(&setup[32], "\x05vorbis", 7);
+  page(ID_HEADER_BYTES, headerBytes - ID_HEADER_BYTES, 1, 0, setup, sizeof(setup));
+
+  // audio
+  if (pos + n <= headerBytes)
+    return;
+  double samplesPerByte = 8.0 * fs / bitrate;
+  uint64_t first = (std::max<uint64_t>(pos, headerBytes) - headerBytes) / PAGE_BYTES;
+  for (uint64_t i = first; pageOffset(i + 2) < pos + n; i++)
+    page(pageOffset(i + 2), PAGE_BYTES, i + 2, std::llround((i + 1) * PAGE_BYTES * samplesPerByte), nullptr, 0);
+}
+
+uint64_t VS1053Model::decoding() const {
+  return std::max(tStart_ + STARTUP_US, tResume_);
+}
+
+double VS1053Model::playedSamples() const {
+  return std::max(0.0, consumed_ - headerBytes) * 8 / bitrate * fs;
+}
+
+double VS1053Model::queuedSamples() const {
+  if (!started_ || starved_ || held() || consumed_ < headerBytes || sim::now <= decoding())
+    return 0;
+  double t = sim::now / 1E6;
+  double sawtooth = AUDIO_BLOCK * (1 - std::fmod(t * fs * speed() / AUDIO_BLOCK, 1.0));
+  double load = AUDIO_WANDER * std::sin(2 * M_PI * t / AUDIO_WANDER_S);
+  double filled = (sim::now - decoding()) / 1E6 * fs * AUDIO_FILL_SPEED;   // after a release
+  return std::min(filled, AUDIO_LOW + load + sawtooth);
+}
+
+double VS1053Model::position() {
+  update();
+  while (jumps_.size() > 1 && jumps_[1].first <= consumed_)
+    jumps_.pop_front();
+  double skipped = (!jumps_.empty() && jumps_[0].first <= consumed_) ? jumps_[0].second : 0;
+  return std::max(0.0, (consumed_ + skipped - headerBytes) * 8 / bitrate * fs - DAC_SAMPLES);
+}
+
+double VS1053Model::speed() const {
+  return 1 + ppm2_ / 524288.0;                // 2^19 ~ "2 ppm" per LSB
+}
+
+uint32_t VS1053Model::counter() {
+  update();
+  return (uint32_t) (playedSamples() + queuedSamples() + counterOffset_);
+}
+
+int32_t VS1053Model::minPpm2() const {
+  return -187000;
+}
+
+int32_t VS1053Model::maxPpm2() const {
+  switch (fs) {
+    case 32000: return 307200;
+    case 44100: return  82427;
+    case 48000: return  34133;
+    default:    return 511999;
+  }
+}
+
+void VS1053Model::start() {
+  update();
+  started_ = true;
+  starved_ = false;
+  tStart_ = last_ = sim::now;
+  tResume_ = 0;
+  fed_ = 0;
+  consumed_ = 0;
+  skipped_ = 0;
+  jumps_.clear();
+  pageIdx_ = 0;
+  updateDREQ();
+}
+
+void VS1053Model::stop() {
+  update();
+  started_ = false;
+  updateDREQ();
+}
+
+uint16_t VS1053Model::sciRead(uint8_t addr) {
+  busTime(SCI_TRANSACTION_US * 1000);
+  sciBytes += playing() ? 4 : 0;
+  sim::busy(SCI_TRANSACTION_US);
+  return regRead(addr);
+}
+
+void VS1053Model::sciWrite(uint8_t addr, uint16_t data) {
+  busTime(SCI_TRANSACTION_US * 1000);
+  sciBytes += playing() ? 4 : 0;
+  sim::busy(SCI_TRANSACTION_US);
+  regWrite(addr, data);
+}
+
+void VS1053Model::select(bool) {
+  sciIdx_ = 0;
+}
+
+uint8_t VS1053Model::transfer(uint8_t b) {
+  // instruction, address, then data words (reads: one, writes: any number)
+  uint8_t out = 0;
+  if (sciIdx_ == 0)
+    sciOp_ = b;
+  else if (sciIdx_ == 1)
+    sciAddr_ = b;
+  else if (sciOp_ == 0x03 && sciIdx_ == 2) {
+    sciWord_ = regRead(sciAddr_);
+    out = sciWord_ >> 8;
+  } else if (sciOp_ == 0x03 && sciIdx_ == 3)
+    out = sciWord_ & 0xFF;
+  else if (sciOp_ == 0x02 && sciIdx_ % 2 == 0)
+    sciWord_ = b << 8;
+  else if (sciOp_ == 0x02)
+    regWrite(sciAddr_, sciWord_ | b);
+  sciIdx_ = std::min(sciIdx_ + 1, 255);
+  sciBytes += playing() ? 1 : 0;
+  return out;
+}
+
+void VS1053Model::busTime(uint32_t ns) {
+  if (playing())
+    sciBusNs += ns;
+}
+
+uint16_t VS1053Model::regRead(uint8_t addr) {
+  switch (addr) {
+  case VS1053_REG_AUDATA:
+    update();
+    if (!started_ || consumed_ < ID_HEADER_BYTES)
+      return 8000;
+    return ((fs == 11025) ? 11024 : fs) | (channels == 2);
+  case VS1053_REG_HDAT0:
+    return (started_) ? bitrate / 64 : 0;
+  case VS1053_REG_HDAT1:
+    return (started_) ? 0x4F67 : 0;           // "Og"
+  case VS1053_REG_WRAMADDR:
+    return wramAddr_;
+  case VS1053_REG_WRAM: {
+    uint16_t a = wramAddr_++;
+    switch (a) {
+    case WRAM_SAMPLECOUNT_LSW: return counter() & 0xFFFF;
+    case WRAM_SAMPLECOUNT_MSW: return counter() >> 16;
+    case WRAM_POSMSEC_LSW:     return (uint32_t) (position() * 1000 / fs) & 0xFFFF;
+    case WRAM_POSMSEC_MSW:     return (uint32_t) (position() * 1000 / fs) >> 16;
+    case WRAM_STREAM_WRP:
+      update();
+      return (uint16_t) std::min(1023.0, (fed_ - consumed_) / 2);
+    case WRAM_STREAM_RDP:      return 0;
+    case WRAM_AUDIO_WRP:       update(); return (uint16_t) queuedSamples() * 2;   // stereo
+    case WRAM_AUDIO_RDP:       return 0;
+    case WRAM_UNDERFLOW:       update(); return wram_[a] + underflows;
+    default:                   return wram_[a];
+    }
+  }
+  default:
+    return 0;
+  }
+}
+
+void VS1053Model::regWrite(uint8_t addr, uint16_t data) {
+  switch (addr) {
+  case VS1053_REG_AUDATA:                     // apply new playback speed
+    update();
+    ppm2_ = (int32_t) (wram_[WRAM_PPM2_LSW] | ((uint32_t) wram_[WRAM_PPM2_MSW] << 16));
+    rateUpdates++;
+    if (ppm2_ <= minPpm2() || ppm2_ >= maxPpm2())
+      rateClamped++;
+    break;
+  case VS1053_REG_WRAMADDR:
+    wramAddr_ = data;
+    break;
+  case VS1053_REG_WRAM: {
+    uint16_t a = wramAddr_++;
+    if (a == WRAM_SAMPLECOUNT_LSW || a == WRAM_SAMPLECOUNT_MSW) {
+      uint32_t c = counter();
+      c = (a == WRAM_SAMPLECOUNT_LSW) ? (c & 0xFFFF0000) | data : (c & 0xFFFF) | ((uint32_t) data << 16);
+      counterOffset_ = c - playedSamples() - queuedSamples();
+    } else if (a == WRAM_UNDERFLOW) {
+      update();
+      wram_[a] = data - underflows;
+    } else if (a == WRAM_PLAYMODE) {          // pause takes effect from now on
+      update();
+      if (held() && !(data & PLAYMODE_PAUSE_ON))
+        tResume_ = sim::now + RESUME_US;      // release: decoding resumes after a while
+      wram_[a] = data;
+      updateDREQ();
+    } else
+      wram_[a] = data;
+    break;
+  }
+  }
+}
+
+}
+
+// Adafruit_VS1053 stand-in, following the original library where it matters
+uint8_t Adafruit_VS1053::begin(void) {
+  digitalWrite(_dcs, HIGH);
+  sim::vs1053.stop();                         // sets DREQ
+  return 4;
+}
+
+uint16_t Adafruit_VS1053::sciRead(uint8_t addr) { return sim::vs1053.sciRead(addr); }
+void Adafruit_VS1053::sciWrite(uint8_t addr, uint16_t data) { sim::vs1053.sciWrite(addr, data); }
+void Adafruit_VS1053::setVolume(uint8_t, uint8_t) { sim::busy(sim::SCI_TRANSACTION_US); }
+bool Adafruit_VS1053::readyForData(void) { return digitalRead(_dreq); }
+
+void Adafruit_VS1053::playData(uint8_t *buffer, uint8_t n) {
+  sim::busy(sim::SDI_OVERHEAD_US + n * 8 / sim::SDI_MHZ);
+  sim::vs1053.sdi(buffer, n);
+}
+
+static Adafruit_VS1053_FilePlayer *myself;
+static void feeder(void) { myself->feedBuffer(); }
+
+bool Adafruit_VS1053_FilePlayer::begin(void) {
+  return Adafruit_VS1053::begin() == 4;
+}
+
+bool Adafruit_VS1053_FilePlayer::useInterrupt(uint8_t type) {
+  myself = this;
+  if (type != VS1053_FILEPLAYER_PIN_INT)
+    return false;
+  SPI.usingInterrupt(digitalPinToInterrupt(_dreq));
+  attachInterrupt(digitalPinToInterrupt(_dreq), feeder, CHANGE);
+  return true;
+}
+
+void Adafruit_VS1053_FilePlayer::feedBuffer(void) {
+  if (feedBufferLock)
+    return;
+  feedBufferLock = true;
+  if (playingMusic && currentTrack) {
+    while (readyForData()) {
+      int bytesread = currentTrack.read(mp3buffer, VS1053_DATABUFFERLEN);
+      if (bytesread <= 0) {
+        playingMusic = false;
+        currentTrack.close();
+        break;
+      }
+      playData(mp3buffer, bytesread);
+    }
+  }
+  feedBufferLock = false;
+}
+
+bool Adafruit_VS1053_FilePlayer::startPlayingFile(const char *trackname) {
+  currentTrack = SD.open(trackname);
+  if (!currentTrack)
+    return false;
+  sim::vs1053.start();
+  playingMusic = true;
+  while (playingMusic && readyForData())
+    feedBuffer();
+  return true;
+}
+
+bool Adafruit_VS1053_FilePlayer::playFullFile(const char *trackname) {
+  if (!startPlayingFile(trackname))
+    return false;
+  while (playingMusic)
+    yield();
+  return true;
+}
+
+void Adafruit_VS1053_FilePlayer::stopPlaying(void) {
+  playingMusic = false;
+  currentTrack.close();
+  sim::vs1053.stop();
+}
+
+bool Adafruit_VS1053_FilePlayer::paused(void) {
+  return !playingMusic && currentTrack;
+}
+
+bool Adafruit_VS1053_FilePlayer::stopped(void) {
+  return !playingMusic && !currentTrack;
+}
+
+void Adafruit_VS1053_FilePlayer::pausePlaying(bool pause) {
+  if (pause)
+    playingMusic = false;
+  else {
+    playingMusic = true;
+    feedBuffer();
+  }
+}
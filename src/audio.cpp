@@ -1,7 +1,9 @@
+#include <SPI.h>
 #include "audio.h"
 #include "projector.h"
 #include "serialdebug.h"
 #include "pins.h"
+#include "profiler.h"
 #include "ui.h"
 
 // #if !defined(__MKL26Z64__)
@@ -10,11 +12,11 @@
 
 #include "TeensyTimerTool.h"
 using namespace TeensyTimerTool;
+#include <IntervalTimer.h>
 #include <QuickPID.h>
 
-#include <EncoderTool.h>
-using namespace EncoderTool;
-extern PolledEncoder enc;
+#include "encoder.h"
+extern RotaryEncoder enc;
 
 
 // macros for time conversion
@@ -29,6 +31,10 @@ extern PolledEncoder enc;
 #define VS1053_XMEM_POSITIONMSEC_0 0x1E27
 #define VS1053_XMEM_POSITIONMSEC_1 0x1E28
 #define VS1053_XMEM_SAMPLECOUNT    0x1800
+#define VS1053_XMEM_RESYNC         0x1E29
+#define VS1053_XMEM_PLAYMODE       0x1E09
+#define PLAYMODE_PAUSE_ON          0x0002
+#define PLAYMODE_RESAMPLER_ON      0x0080
 
 // state labels
 #define CHECK_FOR_LEADER         0
@@ -43,37 +49,90 @@ extern PolledEncoder enc;
 #define SHUTDOWN               254
 #define QUIT                   255
 
-#define PID_FILTER_N            10
+#define PID_TICK_US         100000    // PID sample time
+#define READ_AHEAD_MS          250    // SD latency to be bridged by read-ahead [ms]
+#define CUE_TIMEOUT_MS        3000    // for the decoder to get going and the stream buffer to fill
+#define CUE_FILL_PERCENT        75    // stream buffer fill level when cued
+#define SEEK_LINEAR_BYTES     8192    // bisection stops here, pages are walked one by one
+#define INDEX_VERSION            1    // of the sidecar files (.idx)
+#define DECODER_TIMEOUT_US   20000    // for the sample counter to move after release
+#define IMP_PERIOD_SMOOTHING     4    // time constant of the impulse period [impulses]
+#define DAC_LATENCY_SAMPLES     32    // interpolation filter and DAC (estimate)
+#define RAMP_DEVIATION        0.08f   // projector running down or up: speed off by more than this
+#if !defined(PAUSE_BELOW_PERCENT)
+  #define PAUSE_BELOW_PERCENT   65    // hard pause below this projector speed [%] (ppm2 stops at 64%)
+#endif
+#define RAMP_CATCH_UP_S       0.2f   // projector running down or up: sync error made up within
+#define CREEP_CHECK_US       10000    // while paused, audio and film are compared this often
 
 extern UI ui;
 extern Projector projector;
 
-bool runPID = false;
-PeriodicTimer pidTimer(TCK);
-volatile uint32_t totalImpCounter = 0;
+IntervalTimer tickTimer;                          // PID ticks (PIT), see tickISR()
+#if defined(IMPULSE_CAPTURE)
+ImpulseCapture defaultImpulseSource;
+#else
+ImpulseInterrupt defaultImpulseSource;
+#endif
+
+static Audio *feedInstance = nullptr;             // for the DREQ interrupt (and card watch)
+static volatile bool startmarkArmed = false;      // latch the next falling edge of STARTMARK ...
+static volatile uint32_t startmarkImps = 0;       // ... as the number of impulses pushed by then
 
 // Constructor
-Audio::Audio() : Adafruit_VS1053_FilePlayer{VS1053_RST, VS1053_CS, VS1053_DCS, VS1053_DREQ, VS1053_SDCS} {
+Audio::Audio() : Adafruit_VS1053_FilePlayer{VS1053_RST, VS1053_CS, VS1053_DCS, VS1053_DREQ, VS1053_SDCS},
+#if defined(SDI_DMA)
+                 sdi{VS1053_DCS}, sci{VS1053_CS, &sdi} {
+#else
+                 sci{VS1053_CS} {
+#endif
   pinMode(VS1053_SDCD, INPUT_PULLUP);
+  _impulseSource = &defaultImpulseSource;
+  feedInstance = this;
 }
 
 uint8_t Audio::begin() {
   PRINTLN("Initializing SD card ...");
   if (!SD.begin(VS1053_SDCS))                     // initialize SD library and card
     return 1;
+  scanTracks();
+
+  // the table of tracks is rebuilt after the card has been pulled
+  static PeriodicTimer cardTimer(TCK);
+  cardTimer.begin([]() {
+    if (!feedInstance->SDinserted())
+      feedInstance->_cardRemoved = true;
+  }, 10_Hz);
 
   PRINTLN("Initializing VS1053B ...");
   if (!Adafruit_VS1053_FilePlayer::begin())       // initialize base class
     return 2;
   if (!loadPatch())                               // load & apply patch
     return 3;
-  useInterrupt(VS1053_FILEPLAYER_PIN_INT);        // use VS1053 DREQ interrupt
+  sci.begin();                                    // fast SCI for the hot path
+#if defined(TELEMETRY)
+  _telemetry.begin();
+#endif
+
+  // use VS1053 DREQ interrupt, feeding from the read-ahead buffer (see feed())
+  // instead of Adafruit_VS1053_FilePlayer::useInterrupt()
+  SPI.usingInterrupt(digitalPinToInterrupt(VS1053_DREQ));
+  attachInterrupt(digitalPinToInterrupt(VS1053_DREQ), feedISR, CHANGE);
+#if defined(SDI_DMA)
+  sdi.begin(sdiSent, feedISR);                    // chunks via DMA (see sdi.h)
+#endif
 
   // the DREQ interrupt seems to mess with the timing of the impulse detection
   // which is also using an interrupt. This can be remedied by lowering the
-  // priority of the DREQ interrupt
+  // priority of the DREQ interrupt - or by using the input capture backend,
+  // which latches impulse times in hardware (see impulse.h)
+  //
+  // The PID tick reads the sample counter via SCI. It shares the priority of
+  // the DREQ interrupt, so neither one can cut into the other's SPI
+  // transaction and impulses can still cut into both.
   #if defined(__MKL26Z64__)                       // Teensy LC  [MKL26Z64]
     NVIC_SET_PRIORITY(IRQ_PORTCD, 192);
+    tickTimer.priority(192);
     // This could be a problem. Interrupt priorities for ports C and D cannot be
     // changed independently from one another as they share an IRQ number. Thus,
     // we currently can't prioritize IMPULSE over DREQ on Teensy LC:
@@ -89,6 +148,7 @@ uint8_t Audio::begin() {
 
   #elif defined(__MK20DX256__)                    // Teensy 3.2 [MK20DX256]
     NVIC_SET_PRIORITY(IRQ_PORTC, 144);
+    tickTimer.priority(144);
     //    Pin 02 = IMPULSE   -> Port D0  / IRQ 90
     //    Pin 03 = STARTMARK -> Port A12 / IRQ 87
     //    Pin 10 = DREQ      -> Port C4  / IRQ 89
@@ -106,23 +166,243 @@ bool Audio::SDinserted() {
 }
 
 void Audio::leaderISR() {
-  digitalWriteFast(LED_BUILTIN, digitalReadFast(STARTMARK));
+  bool leader = digitalReadFast(STARTMARK);
+  digitalWriteFast(LED_BUILTIN, leader);
+  if (startmarkArmed && !leader) {
+    startmarkImps = impulseBuffer.pushed();
+    startmarkArmed = false;
+  }
+}
+
+void Audio::setImpulseSource(ImpulseSource *source) {
+  _impulseSource = source;
+}
+
+void Audio::setStartFrame(uint32_t frame) {
+  _startFrame = frame;
+}
+
+bool Audio::startPlayingFile(const char *trackname) {
+  // the base class fills the VS1053B's stream buffer straight from SD, the
+  // read-ahead buffer takes over from there
+  _readAhead.clear(0);
+  _spliceAt    = 0;
+  _seekSamples = 0;
+  if (!Adafruit_VS1053_FilePlayer::startPlayingFile(trackname))
+    return false;
+  if (_startFrame && !planSeek()) {
+    stopPlaying();
+    return false;
+  }
+  _readAhead.clear(currentTrack.position());
+  fillReadAhead();
+  return true;
+}
+
+void Audio::pausePlaying(bool pause) {
+  playingMusic = !pause;
+  if (!pause)
+    feed();
+}
+
+void Audio::fillReadAhead() {
+  // called from the main loop: SD access can take its time here
+  if (!currentTrack)
+    return;
+  PROFILE_SCOPE(PROFILE_READ_AHEAD);
+  if (_spliceAt && currentTrack.position() == _spliceAt && !_readAhead.available())
+    splice();
+  uint32_t end = (_spliceAt) ? _spliceAt : UINT32_MAX;
+#if defined(SDI_DMA)
+  sdi.hold();
+#endif
+  PROFILE_BUS_BEGIN(PROFILE_BUS_SD);
+  _readAhead.fill(currentTrack, end);
+#if defined(SESSION_LOG)
+  if (_log.pending() && _readAhead.available() + READ_AHEAD_SECTOR > _readAhead.depth())
+    _log.flush();                                 // only while there's nothing to read
+#endif
+  PROFILE_BUS_END(PROFILE_BUS_SD);
+#if defined(SDI_DMA)
+  sdi.release();
+#endif
+  if (playingMusic)
+    feed();                                       // DREQ might be waiting already
+  else if (_readAhead.eof() && !_readAhead.available())
+    currentTrack.close();                         // end of file, stopped() from now on
+}
+
+bool Audio::planSeek() {
+  // Playback is to start at the page holding _startFrame. The data sent so far
+  // (headers, maybe the beginning of the audio) is completed up to the next
+  // page boundary, where the file is spliced to that page. The decoder then
+  // plays the few samples sent before the splice, followed by the audio from
+  // the page on: _seekOffset maps the sample count to positions in the file.
+  // The page starts before the target, cue() decodes up to it.
+  File file = SD.open(_filename);
+  OggWalker ogg(&file);
+  uint32_t fs = _vorbis.fs;                           // see cue()
+  size_t audioStart = (_indexed) ? _index.audioStart : firstAudioPage(&file);
+  if (!fs || audioStart == UINT32_MAX) {
+    file.close();
+    return false;
+  }
+  int64_t target = (int64_t) _startFrame * fs * _fps.den / _fps.num;  // as in impsToSamples()
+
+  // look up the page ending just before the target in the index, or bisect
+  // for it: O(log n) reads ...
+  size_t lo = audioStart, hi = file.size();
+  int64_t loGranule = 0;                              // samples before the page at lo
+  if (_indexed && !indexLookup(target, &lo, &loGranule)) {
+    PRINTLN("Not in the index, bisecting.");
+    _indexed = false;
+  }
+  while (!_indexed && lo + SEEK_LINEAR_BYTES < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (!ogg.sync(mid) || ogg.position() >= hi || ogg.granulePos() >= target)
+      hi = mid;
+    else {
+      lo = ogg.nextPosition();
+      loGranule = ogg.granulePos();
+    }
+  }
+
+  // ... and walk from there to the page holding it
+  for (bool ok = ogg.read(lo); ; ok = ogg.next()) {
+    if (!ok) {                                        // beyond end of track
+      file.close();
+      return false;
+    }
+    if (ogg.granulePos() >= target)
+      break;
+    if (ogg.granulePos() >= 0)
+      loGranule = ogg.granulePos();
+  }
+  _spliceTo = ogg.position();
+
+  // splice at the end of the page the base class has stopped in
+  int64_t sentGranule = 0;                            // samples decoded before the splice
+  size_t pos;
+  for (pos = audioStart; pos < currentTrack.position(); pos = ogg.nextPosition()) {
+    if (!ogg.read(pos)) {
+      file.close();
+      return false;
+    }
+    if (ogg.granulePos() >= 0)
+      sentGranule = ogg.granulePos();
+  }
+  _spliceAt    = pos;
+  _seekOffset  = sentGranule - loGranule;
+  _seekSamples = target + _seekOffset;
+  file.close();
+
+  PRINTF("Seeking to frame %lu: page at %lu (sample %lld), splice at %lu\n",
+    _startFrame, _spliceTo, loGranule, _spliceAt);
+  return true;
+}
+
+void Audio::splice() {
+  // everything up to the splice has been sent, continue at the start page
+  _feedLock = true;                               // keep the DREQ interrupt out
+  uint16_t depth = _readAhead.depth();
+  currentTrack.seek(_spliceTo);
+  _readAhead.clear(_spliceTo);
+  _readAhead.setDepth(depth);
+  sciWriteWRAM16(VS1053_XMEM_RESYNC, 32767);      // allow for the jump (section 10.11)
+  _spliceAt = 0;
+  _feedLock = false;
+}
+
+void Audio::feed() {
+  PROFILE_SCOPE(PROFILE_FEEDER);
+  if (_feedLock)                                  // the main loop is feeding already
+    return;
+  _feedLock = true;
+  uint8_t *data;
+#if defined(SDI_DMA)
+  // one chunk at a time, the next one is started from the DMA interrupt
+  if (playingMusic && !sdi.busy() && readyForData()) {
+    uint16_t n = _readAhead.peek(data, VS1053_DATABUFFERLEN);
+    if (n > 0)
+      sdi.send(data, n);                          // consumed in sdiSent()
+    else if (_readAhead.eof())
+      playingMusic = false;
+  }
+#else
+  while (playingMusic && readyForData()) {
+    uint16_t n = _readAhead.peek(data, VS1053_DATABUFFERLEN);
+    if (n == 0) {                                 // buffer ran dry
+      if (_readAhead.eof())
+        playingMusic = false;
+      break;
+    }
+    PROFILE_BUS_BEGIN(PROFILE_BUS_VS1053);
+    playData(data, n);
+    PROFILE_BUS_END(PROFILE_BUS_VS1053);
+    _readAhead.consume(n);
+  }
+#endif
+  _feedLock = false;
+}
+
+void Audio::feedISR() {
+  feedInstance->feed();
+}
+
+void Audio::tickISR() {
+  feedInstance->sampleTick();
+}
+
+void Audio::sdiSent(uint8_t n) {
+  feedInstance->_readAhead.consume(n);
 }
 
-void Audio::countISR() {
-  static unsigned long lastMicros = 0;
-  unsigned long thisMicros = micros();
+void Audio::sendBuffer() {
+  // the display shares the SPI bus with SDI
+  PROFILE_BUS_BEGIN(PROFILE_BUS_DISPLAY);
+#if defined(SDI_DMA)
+  sdi.hold();
+  u8g2->sendBuffer();
+  sdi.release();
+#else
+  u8g2->sendBuffer();
+#endif
+  PROFILE_BUS_END(PROFILE_BUS_DISPLAY);
+}
 
-  if ((thisMicros - lastMicros) > 2000) {         // poor man's debounce - no periods below 2ms (500Hz)
-    noInterrupts();
+void Audio::countImpulses() {
+  // drain timestamps collected by the impulse source
+  _impulseSource->poll();
+  uint32_t t;
+  while (impulseBuffer.pop(t)) {
+    uint32_t period = t - lastImpMicros;
     totalImpCounter++;
-    lastMicros = thisMicros;
-    interrupts();
-    digitalToggleFast(LED_BUILTIN);               // toggle the LED
+    impulsesCounted++;
+    lastImpMicros = t;
+    impInterval = period;
+    if (totalImpCounter == 2 || period > 3 * impPeriod || 3 * period < impPeriod)
+      impPeriod = period;                         // first one, or (end of) a stop
+    else                                          // smoothed over blades and jitter
+      impPeriod += (int32_t) (period - impPeriod) / IMP_PERIOD_SMOOTHING;
   }
+
+  // impulses that didn't fit into the buffer still count
+  uint32_t overruns = impulseBuffer.overruns();
+  totalImpCounter += overruns - impulseOverruns;
+  impulsesCounted += overruns - impulseOverruns;
+  impulseOverruns = overruns;
 }
 
-bool Audio::selectTrack() {
+void Audio::startImpulseCounter() {
+  impulseBuffer.clear();
+  impulseBase = impulseBuffer.pushed();
+  impulsesCounted = impulseBase;
+  impulseOverruns = 0;
+  totalImpCounter = 0;
+  _impulseSource->begin();
+}
+
+bool Audio::selectTrack(bool tune) {
   EEPROMstruct pConf = projector.config();        // get projector configuration
   uint8_t state = CHECK_FOR_LEADER;
   bool showOffsetCorrectionInput = false;
@@ -146,51 +426,41 @@ bool Audio::selectTrack() {
   if (!digitalReadFast(STARTMARK))                            // check for leader
     state = OFFER_MANUAL_START;
 
-  // 3. Busy bee is working hard ...
-  u8g2->clearBuffer();
-  u8g2->setFont(FONT10);
-  u8g2->drawStr(8,50,"Loading...");
-  PeriodicTimer beeTimer(TCK);
-  beeTimer.begin([]() { ui.drawBusyBee(90, 10); }, 30_Hz);
+  // 3. & 4. Cue file
+  if (!cue())
+    return false;                                             // back to track selection
 
-  // 4. Cue file
-  PRINT("Loading \"");
-  PRINT(_filename);
-  PRINTLN("\"");
-  setVolume(254,254);                 // mute
-  clearSampleCounter();
-  startPlayingFile(_filename);        // start playback
-  while (getSamplingRate()==8000) {}  // wait for correct data
-  _fsPhysical = getSamplingRate();    // get physical sampling rate
-  pausePlaying(true);                 // and pause again
-  PRINT("Sampling rate: ");
-  PRINT(_fsPhysical);
-  PRINTLN(" Hz");
-  enableResampler(_fsPhysical > 24000);     // enable 15/16 resampler if necessary
-  delay(500);                               // wait for things to settle ...
-  setVolume(4,4);                           // raise volume back up for playback
+#if defined(SESSION_LOG)
+  char logName[sizeof(_filename)];                            // "001-24.log"
+  sidecarName(logName, ".log");
+  if (!_log.begin(logName, sessionHeader())) {
+    PRINTLN("Can't open session log.");                       // play on, unlogged
+  }
+#endif
 
-  // 5. Define some conversion factors
-  impToSamplerateFactor    = _fsPhysical / _fps / pConf.shutterBladeCount;
-  deltaToFramesDivider     = _fsPhysical / _fps;
-  impToAudioSecondsDivider = _fps * pConf.shutterBladeCount;
+  // 5. Samples per impulse, as a fraction (see impsToSamples)
+  samplesPerImpNum         = (uint32_t) _fsPhysical * _fps.den;
+  samplesPerImpDen         = (uint32_t) _fps.num * pConf.shutterBladeCount;
 
   // 6. Reset variables
   _frameOffset             = 0;
   sampleCountBaseLine      = 0;
-  lastSampleCounterHaltPos = 0;
   syncOffsetImps           = 0;
   Setpoint                 = 0;
   Input                    = 0;
   Output                   = 0;
-  while (average(0) != 0) {}
+  _filter                  = pConf.filter;
+  _autoTune                = AutoTune();            // result of an earlier run
+  _rampTicks               = 0;
+  _average.clear();
+  _tracker.clear();
 
   // 7. Prepare PID
   myPID.SetMode(myPID.Control::timer);
   myPID.SetProportionalMode(myPID.pMode::pOnMeas);
   myPID.SetDerivativeMode(myPID.dMode::dOnMeas);
   myPID.SetAntiWindupMode(myPID.iAwMode::iAwClamp);
-  myPID.SetTunings(pConf.p, pConf.i, pConf.d);
+  myPID.SetTunings(pConf.kp(), pConf.ki(), pConf.kd());
 
   // Adafruit VS1035 breakout uses a 12.288 Mhz XTALI, upper limit for sample
   // rate at 48 kHz.  Using the 15/16 resampler we have more headroom for
@@ -213,79 +483,134 @@ bool Audio::selectTrack() {
   // https://www.vlsi.fi/fileadmin/software/VS10XX/vs1053b-patches.pdf
 
   switch (_fsPhysical) {
-    case 32000: myPID.SetOutputLimits(-187000, 307200); break;
-    case 44100: myPID.SetOutputLimits(-187000,  82430); break;
-    case 48000: myPID.SetOutputLimits(-187000,  34133); break;
-    default:    myPID.SetOutputLimits(-187000, 511999); break;
+    case 32000: ppmLimitMax = 307200; break;
+    case 44100: ppmLimitMax =  82430; break;
+    case 48000: ppmLimitMax =  34133; break;
+    default:    ppmLimitMax = 511999; break;
   }
+  myPID.SetOutputLimits(ppmLimitMin, ppmLimitMax);
 
   // 8. Run state machine
-  beeTimer.stop();
   while (state != QUIT) {
     yield();
+    countImpulses();
+    fillReadAhead();
+#if defined(TELEMETRY)
+    _telemetry.pump();
+#endif
 
     switch (state) {
     case CHECK_FOR_LEADER:
       if (digitalReadFast(STARTMARK)) {
         PRINT("Waiting for start mark ... ");
         drawWaitForPlayingMenu();
+        startImpulseCounter();                        // count from here, leaderISR() marks the end
+        startmarkArmed = true;
         state = WAIT_FOR_STARTMARK;
       } else
         state = OFFER_MANUAL_START;
       break;
 
-    case OFFER_MANUAL_START:
-      if (ui.userInterfaceMessage("Can't detect film leader.",
-                                  "Trigger manual start?", "",
-                                  " Cancel \n OK ") == 2) {
+    case OFFER_MANUAL_START: {
+      uint8_t choice = ui.userInterfaceMessage("Can't detect film leader.",
+                                               "Trigger manual start?", "",
+                                               " Cancel \n OK \n Seek ");
+      if (choice == 3) {                              // restart mid-reel
+        _startFrame = startFrameScreen();
+        stopPlaying();
+        if (!cue())
+          choice = 1;
+      }
+      if (choice >= 2) {
         state = START;
         detachInterrupt(STARTMARK);
-        attachInterrupt(IMPULSE, countISR, RISING); // start impulse counter
+        startImpulseCounter();
+        _startImpulse = 0;
       } else
         state = SHUTDOWN; // back to main-menu
       break;
+    }
 
     case WAIT_FOR_STARTMARK:
-      if (digitalReadFast(STARTMARK))
-        continue; // there is still leader
+      if (startmarkArmed) {
+        if (digitalReadFast(STARTMARK))
+          continue; // there is still leader
+        leaderISR();                                  // edge went unnoticed: latch it now
+      }
       PRINTLN("Hit!");
       PRINT("Waiting for ");
       PRINT(pConf.startmarkOffset);
       PRINTLN(" frames ...");
       detachInterrupt(STARTMARK);
       digitalWriteFast(LED_BUILTIN, LOW);
-      totalImpCounter = 0;
-      attachInterrupt(IMPULSE, countISR, RISING); // start impulse counter
+      _startImpulse = (startmarkImps - impulseBase) + pConf.startmarkOffset * pConf.shutterBladeCount;
       state = WAIT_FOR_OFFSET;
       break;
 
     case WAIT_FOR_OFFSET:
-      if ((totalImpCounter/pConf.shutterBladeCount) < pConf.startmarkOffset)
+      // once the period is known, playback is started an impulse early (see START)
+      if (totalImpCounter + (totalImpCounter >= 2) < _startImpulse)
         continue;
       state = START;
       break;
 
-    case START:
-      totalImpCounter = 0;
+    case START: {
+      // Impulses counted since the start impulse still count. Ahead of it,
+      // the audio is one impulse behind the counter and the decoder is
+      // released when the start impulse is due (a period after the one
+      // before it) less the latency of decoder and DAC.
+      uint32_t late = totalImpCounter - _startImpulse;
+      uint32_t count = getSampleCount();
+      sampleCountBaseLine = (_startFrame) ? _seekOffset : count;
+      if ((int32_t) late < 0) {
+        late = 0;
+        sampleCountBaseLine -= impsToSamples(1);
+        int32_t wait = lastImpMicros + impPeriod - _decoderLatency - _impulseSource->now()
+                     - DAC_LATENCY_SAMPLES * 1000000UL / _fsPhysical;
+        if (wait > 0)
+          delayMicroseconds(wait);
+      }
+      totalImpCounter = _startFrame * pConf.shutterBladeCount + late;
+      uint32_t released = micros();
+      holdDecoder(false);                             // cued: stream buffer is full
       pausePlaying(false);
-      PRINTLN("Starting playback.");
-      sampleCountBaseLine = getSampleCount();
-      pidTimer.begin([]() { runPID = true; }, 10_Hz);
+      while (getSampleCount() == count && micros() - released < DECODER_TIMEOUT_US) {}
+      if (micros() - released < DECODER_TIMEOUT_US)
+        _decoderLatency = micros() - released;
+      PRINTF("Starting playback (decoder latency %lu us).\n", _decoderLatency);
+#if defined(TELEMETRY)
+      sendSession();
+#endif
+      resetSpeedEstimate();
+      clearErrorCounter();
+      health.clear();
+#if defined(PROFILE)
+      profiler.start();
+#endif
+      if (tune)
+        _autoTune.begin(PID_TICK_US, impsToSamples(1));   // see autoTuneStep()
+      _jitter.clear(PID_TICK_US);
+      startTicks();
       buzzer.play(1000,42); // play 2-pop ;-)
       enc.setValue(0);
       enc.buttonChanged();
       state = PLAYING;
       break;
+    }
 
     case PLAYING:
-      if (runPID) {
-        speedControlPID();
-        runPID = false;
-        state  = handlePause();
+      if (_tickSampled) {
+        noInterrupts();
+        tickSample sample = _tickSample;
+        _tickSampled = false;
+        interrupts();
+        speedControlPID(sample);
       }
+      state = handlePause(false);
 
       if (enc.buttonChanged() && enc.getButton()) {
         showOffsetCorrectionInput = !showOffsetCorrectionInput;
+        enc.setAcceleration(showOffsetCorrectionInput);   // +/- 100 frames with a flick
         if (showOffsetCorrectionInput)
           enc.setValue(syncOffsetImps / pConf.shutterBladeCount);
         else {
@@ -305,109 +630,470 @@ bool Audio::selectTrack() {
       break;
 
     case PAUSE:
-      lastSampleCounterHaltPos = getSampleCount();
-      pausePlaying(true);
+      holdDecoder(true);                              // stops right here, stream buffer stays full
+      _creeping = false;
+      adjustSamplerate(ppmLimitMin);                  // for creep()
       PRINTLN("Pausing playback.");
+      _autoTune.cancel();                             // no valid result across a stop
       myPID.SetMode(myPID.Control::manual);
-      pidTimer.stop();
+      stopTicks();
       state = PAUSED;
       break;
 
     case PAUSED:
       drawPlayingMenu();
-      state = handlePause();
+      state = handlePause(true);
+      if (state == PAUSED)
+        creep();
       break;
 
     case RESUME:
+      // pick up the projector's speed while it is still spinning up
+      adjustSamplerate(constrain(rampFeedForward(true), ppmLimitMin, ppmLimitMax));
+      holdDecoder(false);
       myPID.SetMode(myPID.Control::timer);
-      pidTimer.start();
-      restoreSampleCounter(lastSampleCounterHaltPos);
-      pausePlaying(false);
+      startTicks();
+      resetSpeedEstimate();
+      _tracker.clearRate();
       PRINTLN("Resuming playback.");
       state = PLAYING;
       break;
 
     case SHUTDOWN:
       stopPlaying();
+      _autoTune.cancel();
       myPID.SetMode(myPID.Control::manual);
-      pidTimer.stop();
+      stopTicks();
+      enc.setAcceleration(false);
       PRINTLN("Stopped playback.");
-      detachInterrupt(IMPULSE);
+      health.print();
+      _jitter.print();
+#if defined(PROFILE)
+      profiler.stop();
+      profiler.print();
+#endif
+#if defined(SESSION_LOG)
+      _log.end(sessionHeader());
+#endif
+      _impulseSource->end();
+      _startFrame = 0;
+      indexTrack();                                   // for a seek after a film break
       state = QUIT;
     }
   }
+  if (tune)
+    saveTuning();
   u8g2->setFont(FONT10);
   return true;
 }
 
-uint8_t Audio::handlePause() {
-  static uint16_t pauseDetectedPeriod = (1000 / _fps * 3);
-  static uint32_t prevTotalImpCounter = 0;
-  static uint32_t lastImpMillis;
-
-  bool impsChanged = (totalImpCounter + syncOffsetImps) != prevTotalImpCounter;
-
-  if (paused()) {
-    if (impsChanged)
-      return RESUME;
-    else
-      return PAUSED;
-  } else {
-    if (impsChanged && !paused()) {
-      prevTotalImpCounter = totalImpCounter + syncOffsetImps;
-      lastImpMillis = millis();
-    } else if ((millis() - lastImpMillis) >= pauseDetectedPeriod) {
-      return PAUSE;
-    }
-    return PLAYING;
+bool Audio::cue() {
+  // 3. Busy bee is working hard ...
+  u8g2->clearBuffer();
+  u8g2->setFont(FONT10);
+  u8g2->drawStr(8,50,"Loading...");
+  PeriodicTimer beeTimer(TCK);
+  beeTimer.begin([]() { ui.drawBusyBee(90, 10); }, 30_Hz);
+
+  // 4. Cue file: the stream parameters are known from its identification
+  // header, the decoder is stopped once it's through the headers (and the
+  // seek) and the stream buffer is filled up while it waits for the start
+  PRINT("Loading \"");
+  PRINT(_filename);
+  PRINTLN("\"");
+  auto fail = [&](const char *msg1, const char *msg2) {
+    stopPlaying();
+    holdDecoder(false);
+    setVolume(4,4);
+    beeTimer.stop();
+    _startFrame = 0;
+    return ui.showError(msg1, msg2);
+  };
+  File file = SD.open(_filename);
+  bool vorbis = readVorbisID(&file, &_vorbis);
+  if (vorbis && _startFrame)                // seek by index if there is one, else bisect
+    _indexed = readIndex(&file);
+  file.close();
+  if (!vorbis)
+    return fail("Not an Ogg Vorbis", "file.");
+  _fsPhysical = _vorbis.fs;
+  _audata = (_vorbis.fs & 0xfffe) | (_vorbis.channels > 1);  // shadow AUDATA ...
+  _hdat1  = 0x4F67;                                         // ... and HDAT1 ("Og")
+  PRINT("Sampling rate: ");
+  PRINT(_fsPhysical);
+  PRINTLN(" Hz");
+  enableResampler(_fsPhysical > 24000);     // enable 15/16 resampler if necessary
+
+  setVolume(254,254);                       // mute
+  holdDecoder(false);
+  clearSampleCounter();
+  if (!startPlayingFile(_filename))         // start playback (at _startFrame)
+    return fail("Can't start playback", "at this position.");
+  // Decode until audio comes out - after a seek, until the start frame is
+  // heard: the page spliced to begins ahead of it.
+  auto decoding = [this]() {
+    int16_t audioFill;
+    if (_spliceAt || getSampleCount() == 0)
+      return true;
+    return _seekSamples && (int32_t) (getHeardSampleCount(&audioFill) - _seekSamples) < 0;
+  };
+  uint32_t start = millis();
+  while (decoding()) {
+    fillReadAhead();
+    yield();                                      // busy bee
+    if (millis() - start > CUE_TIMEOUT_MS)
+      return fail("Can't decode", "this file.");
   }
+  holdDecoder(true);
+  start = millis();
+  _readAhead.setDepth(((_vorbis.bitrate) ? _vorbis.bitrate : getBitrate()) * READ_AHEAD_MS / 1000);
+  while (StreamBufferFillWords() < StreamBufferSizeWords() * CUE_FILL_PERCENT / 100) {
+    fillReadAhead();
+    yield();
+    if (millis() - start > CUE_TIMEOUT_MS)
+      return fail("Can't read", "this file.");
+  }
+  pausePlaying(true);                       // and pause feeding
+  while (AudioBufferFillWords() > 0 && millis() - start < CUE_TIMEOUT_MS)
+    yield();                                // let the decoded audio play out muted ...
+  setVolume(4,4);                           // ... raise volume back up for playback
+  beeTimer.stop();
+  PRINTF("Cued in %lu ms\n", millis() - start);
+  return true;
+}
+
+uint8_t Audio::handlePause(bool held) {
+  // hard pause only where the playback speed can't follow the projector,
+  // checked on every pass of the main loop: a run-down is over in a tick or two
+  bool slow = impulseRate(true) < PAUSE_BELOW_PERCENT / 100.0f;
+  if (held)
+    return (slow) ? PAUSED : RESUME;
+  return (slow) ? PAUSE : PLAYING;
+}
+
+void Audio::creep() {
+  // Below the range of the playback speed, the film still runs on while the
+  // projector runs down, and before it has spun up again. The audio is held,
+  // and released at the lowest speed whenever the film has got ahead of it.
+  // So it follows the film in small steps, instead of resuming some frames
+  // behind.
+  if (micros() - _creepCheck < CREEP_CHECK_US)
+    return;
+  _creepCheck = micros();
+  int16_t audioFill;
+  uint32_t actualSampleCount = getHeardSampleCount(&audioFill) - sampleCountBaseLine;
+  int32_t desiredSampleCount = impsToSamples(totalImpCounter + syncOffsetImps);
+  if (impInterval) {                    // the film has moved on since the last impulse
+    uint32_t since = _impulseSource->now() - lastImpMicros;
+    if (since > impInterval)
+      since = impInterval;
+    desiredSampleCount += (int64_t) impsToSamples(1) * since / impInterval;
+  }
+  bool behind = (int32_t) (actualSampleCount - desiredSampleCount) < 0;
+  if (behind != _creeping) {
+    _creeping = behind;
+    holdDecoder(!behind);
+  }
+}
+
+float Audio::impulseRate(bool latest) {
+  // Projector speed relative to nominal, over the last few impulses - or the
+  // last one, if that was shorter and asked for (spinning up). A stop shows
+  // as the next impulse being overdue, but a single missing impulse (dirt on
+  // the sensor) doesn't count as one.
+  uint32_t overdue = _impulseSource->now() - lastImpMicros;
+  uint32_t period = (overdue > 2 * impPeriod) ? overdue
+                  : (latest && impInterval < impPeriod) ? impInterval : impPeriod;
+  if (!period)
+    return 0;
+  return 1E6f * samplesPerImpNum / samplesPerImpDen / _fsPhysical / period;
+}
+
+float Audio::rampFeedForward(bool latest) {
+  // as speedFeedForward(), from impulseRate()
+  return (impulseRate(latest) - 1) * 524288;
+}
+
+int32_t Audio::impsToSamples(int32_t imps) {
+  // Exact: at 44.1 kHz, 16 fps and two blades an impulse is 1378.125 samples.
+  // Truncated to 1378, the audio would fall behind by a third of a second an hour.
+  return (int64_t) imps * samplesPerImpNum / samplesPerImpDen;
+}
+
+void Audio::startTicks() {
+  _tickSample  = {};                              // no period across a pause
+  _tickSampled = false;
+  tickTimer.begin(tickISR, PID_TICK_US);
+  SPI.usingInterrupt(tickTimer);                  // held off by other transactions
 }
 
-void Audio::speedControlPID() {
-  uint32_t actualSampleCount = getSampleCount() - sampleCountBaseLine;
-  int32_t desiredSampleCount = (totalImpCounter + syncOffsetImps) * impToSamplerateFactor;
+void Audio::stopTicks() {
+  SPI.notUsingInterrupt(tickTimer);
+  tickTimer.end();
+}
+
+void Audio::sampleTick() {
+  // The sample counter and the number of impulses are taken here, at the
+  // tick of a hardware timer, rather than whenever the main loop gets around
+  // to the PID. Only an SPI transaction in progress can delay the sample.
+  PROFILE_SCOPE(PROFILE_TICK);
+  tickSample s;
+  s.micros  = micros();
+  s.samples = getHeardSampleCount(&s.audioFill);
+  s.pushed  = impulseBuffer.pushed();
+  s.period  = (_tickSample.micros) ? s.micros - _tickSample.micros : 0;
+  _tickSample  = s;
+  _tickSampled = true;
+}
+
+void Audio::speedControlPID(const tickSample &sample) {
+  PROFILE_SCOPE(PROFILE_PID);
+  if (sample.period)
+    _jitter.add(sample.period, micros() - sample.micros);
+
+  // SCI traffic since the previous tick, the tick interrupt adds to it
+  noInterrupts();
+  sciBytesPerTick  = sci.bytes;
+  sciMicrosPerTick = sci.busMicros;
+  sci.bytes        = 0;
+  sci.busMicros    = 0;
+  interrupts();
+
+  // impulses counted since the sample was taken are left to the next tick
+  countImpulses();
+  int32_t since = impulsesCounted - sample.pushed;
+  uint32_t imps = totalImpCounter - ((since > 0) ? since : 0);
+  uint32_t actualSampleCount = sample.samples - sampleCountBaseLine;
+  int32_t desiredSampleCount = impsToSamples(imps + syncOffsetImps);
   long delta = (actualSampleCount - desiredSampleCount);
 
-  Input = average(delta);
+  // The projector's speed, as estimated from the impulse intervals, is fed
+  // forward directly. The PID only needs to correct the remaining phase error.
+  // While the projector runs down or up, the mean speed over the last second
+  // lags behind, so the speed over the last few impulses is used instead,
+  // until the window has filled up again. The filtered sync error lags as
+  // well, so meanwhile the error is made up directly, within RAMP_CATCH_UP_S.
+  Input = (_filter == FILTER_TRACKER) ? _tracker.add(delta) : (pidValue) _average.add(delta) * PID_ONE;
+  float feedForward = speedFeedForward();
+  float ramp = rampFeedForward(false);
+  if (fabsf(ramp - feedForward) > RAMP_DEVIATION * 524288) {
+    resetSpeedEstimate();                         // start over once the speed has settled ...
+    _rampTicks = SPEED_WINDOW_N;                  // ... and the window has filled up again
+  }
+  bool ramping = _rampTicks > 0;
+  if (ramping) {
+    _rampTicks--;
+    feedForward = ramp - (int32_t) delta * 524288.0f / (_fsPhysical * RAMP_CATCH_UP_S);
+  }
   myPID.Compute();
-  adjustSamplerate(Output);
+  if (_autoTune.running())
+    autoTuneStep(ramping);
+  adjustSamplerate(constrain(feedForward + Output, ppmLimitMin, ppmLimitMax));
+
+#if defined(FIXED_PID)
+  _frameOffset = (int64_t) Input * _fps.num / ((int64_t) _fsPhysical * _fps.den * PID_ONE);
+#else
+  _frameOffset = Input * _fps.num / ((float) _fsPhysical * _fps.den);
+#endif
+  sampleBufferHealth(sample.audioFill);
+#if defined(SESSION_LOG)
+  logTick(sample.micros, imps, actualSampleCount, delta, ramping);
+#endif
+#if defined(TELEMETRY)
+  sendTick(sample.micros, imps, delta, feedForward, ramping);   // live, see tools/telemetry.py
+#endif
+}
+
+void Audio::autoTuneStep(bool ramping) {
+  // The relay overrides the PID's output during the experiment. Once it's
+  // done, the PID carries on with the tuned gains, starting from the mean
+  // output of the relay.
+  if (ramping)
+    _autoTune.cancel();                           // projector changed speed, no valid result
+  pidValue pid = Output;
+  Output = _autoTune.relay(Input / (float) PID_ONE, Output);
+  if (_autoTune.running())
+    return;
+  if (!_autoTune.done()) {
+    Output = pid;
+    return;
+  }
+  myPID.SetTunings(_autoTune.p / 100.0f, _autoTune.i / 100.0f, _autoTune.d / 100.0f);
+  myPID.SetMode(myPID.Control::manual);
+  Output = _autoTune.bias();
+  myPID.SetMode(myPID.Control::timer);            // picks up Output
+}
 
-  _frameOffset = Input / deltaToFramesDivider;
+void Audio::saveTuning() {
+  if (_autoTune.failed()) {
+    ui.showError("Auto-tune failed.", "Gains unchanged.");
+    return;
+  }
+  if (!_autoTune.done())
+    return;                                       // never started
+  char pi[24], d[16];                             // one line each, ~20 chars fit
+  snprintf(pi, sizeof(pi), "P %u.%02u  I %u.%02u", _autoTune.p / 100, _autoTune.p % 100,
+           _autoTune.i / 100, _autoTune.i % 100);
+  snprintf(d, sizeof(d), "D %u.%02u", _autoTune.d / 100, _autoTune.d % 100);
+  if (ui.userInterfaceMessage("Save tuned gains?", pi, d, " Cancel \n Save ") == 2)
+    projector.setGains(_autoTune.p, _autoTune.i, _autoTune.d);
+}
 
-  //This puts nifty CSV to the Console, to graph PID results.
-  //PRINTF("Input:%7.0f,Output:%7.0f,FrameOffset:%4d\n", (float) delta/10, Output, _frameOffset);
-  //PRINTF("Input:%0.3f,Output:%0.3f\n", Input, Output);
-  //PRINTF("P:%0.5f,I:%0.5f,D:%0.5f\n", myPID.GetPterm(), myPID.GetIterm(), myPID.GetDterm());
-  //PRINTF("SteamBufferFill:%4d,AudioBufferFill:%4d,AudioBufferUnderflow:%2d\n",StreamBufferFillWords(),AudioBufferFillWords(),AudioBufferUnderflow());
+#if defined(SESSION_LOG)
+logHeader Audio::sessionHeader() {
+  EEPROMstruct pConf = projector.config();
+  logHeader h;
+  h.track          = _trackNum;
+  h.fs             = _fsPhysical;
+  h.fpsNum         = _fps.num;
+  h.fpsDen         = _fps.den;
+  h.blades         = pConf.shutterBladeCount;
+  h.filter         = pConf.filter;
+  h.p              = pConf.p;
+  h.i              = pConf.i;
+  h.d              = pConf.d;
+  h.pFrac          = pConf.pFrac;
+  h.iFrac          = pConf.iFrac;
+  h.dFrac          = pConf.dFrac;
+  strcpy(h.projector, pConf.name);
+  h.tickMicros     = PID_TICK_US;
+  h.startFrame     = _startFrame;
+  h.decoderLatency = _decoderLatency;
+  return h;
+}
+
+void Audio::logTick(uint32_t tickMicros, uint32_t impulses, uint32_t samples, int32_t delta, bool ramping) {
+  logRecord r;
+  r.micros     = tickMicros;
+  r.impulses   = impulses;
+  r.samples    = samples;
+  r.delta      = delta;
+  r.input      = Input / (float) PID_ONE;
+  r.output     = Output;
+  r.syncOffset = syncOffsetImps;
+  r.underflows = health.underflows;
+  r.readAhead  = health.readAhead.now;
+  r.stream     = health.stream.now;
+  r.audio      = health.audio.now;
+  r.flags      = ((ramping) ? LOG_RAMP : 0) | ((_autoTune.running()) ? LOG_TUNE : 0);
+  _log.add(r);
+}
+#endif
+
+#if defined(TELEMETRY)
+void Audio::sendSession() {
+  EEPROMstruct pConf = projector.config();
+  telemetrySession s;
+  s.track      = _trackNum;
+  s.fs         = _fsPhysical;
+  s.fpsNum     = _fps.num;
+  s.fpsDen     = _fps.den;
+  s.blades     = pConf.shutterBladeCount;
+  s.filter     = pConf.filter;
+  s.p          = pConf.p;
+  s.i          = pConf.i;
+  s.d          = pConf.d;
+  s.startFrame = _startFrame;
+  s.pFrac      = pConf.pFrac;
+  s.iFrac      = pConf.iFrac;
+  s.dFrac      = pConf.dFrac;
+  _telemetry.send(TELEMETRY_SESSION, &s, sizeof(s));
+}
+
+void Audio::sendTick(uint32_t tickMicros, uint32_t impulses, int32_t delta, float feedForward, bool ramping) {
+  telemetryTick t;
+  t.micros      = tickMicros;
+  t.impulses    = impulses;
+  t.delta       = delta;
+  t.input       = Input / (float) PID_ONE;
+  t.frames      = t.input * _fps.num / ((float) _fsPhysical * _fps.den);
+  t.pTerm       = myPID.GetPterm();
+  t.iTerm       = myPID.GetIterm();
+  t.dTerm       = myPID.GetDterm();
+  t.output      = Output;
+  t.feedForward = feedForward;
+  t.sciMicros   = (sciMicrosPerTick < UINT16_MAX) ? sciMicrosPerTick : UINT16_MAX;
+  t.readAhead   = health.readAhead.now;
+  t.stream      = health.stream.now;
+  t.audio       = health.audio.now;
+  t.flags       = ((ramping) ? TELEMETRY_RAMP : 0) | ((_autoTune.running()) ? TELEMETRY_TUNE : 0);
+  _telemetry.send(TELEMETRY_TICK, &t, sizeof(t));
+}
+#endif
+
+void Audio::sampleBufferHealth(int16_t audio) {
+  sci.beginBurst();
+  int16_t  stream = StreamBufferFillWords();
+  uint16_t uFlow  = AudioBufferUnderflow();
+  sci.endBurst();
+  health.readAhead.add(_readAhead.available(), _readAhead.depth());
+  health.stream.add(stream, StreamBufferSizeWords());
+  health.audio.add(audio, 4096);
+  health.tick(uFlow);
+}
+
+void Audio::resetSpeedEstimate() {
+  speedWindowImps[0]   = totalImpCounter;
+  speedWindowMicros[0] = lastImpMicros;
+  for (uint8_t i = 1; i < SPEED_WINDOW_N; i++) {
+    speedWindowImps[i]   = speedWindowImps[0];
+    speedWindowMicros[i] = speedWindowMicros[0];
+  }
+  speedWindowIdx = 0;
+}
+
+float Audio::speedFeedForward() {
+  // Timestamps of the latest impulse are stored once per PID tick. The number
+  // of impulses between the oldest and the newest timestamp in the window
+  // divided by their time difference gives the mean impulse rate over the last
+  // second - without quantization to full impulses per tick.
+  uint8_t oldest = (speedWindowIdx + 1) % SPEED_WINDOW_N;
+  speedWindowImps[oldest]   = totalImpCounter;
+  speedWindowMicros[oldest] = lastImpMicros;
+  uint8_t newest = oldest;
+  oldest = (oldest + 1) % SPEED_WINDOW_N;
+  speedWindowIdx = newest;
+
+  uint32_t imps   = speedWindowImps[newest] - speedWindowImps[oldest];
+  uint32_t dt     = speedWindowMicros[newest] - speedWindowMicros[oldest];
+  if (imps < 2 || dt == 0)
+    return 0;
+
+  // relative deviation of the projector's sample rate from the nominal one, as
+  // ppm2 value (2^19 = 100%, see adjustSamplerate)
+  float fs = (float) imps * samplesPerImpNum / samplesPerImpDen * 1E6f / dt;
+  return (fs / _fsPhysical - 1) * 524288;
 }
 
 void Audio::drawPlayingMenuConstants() {
   u8g2->setFont(FONT08);
-  u8g2->drawStr(0, 8, projector.config().name);
-  char buffer[9];
+  u8g2->drawStr(0, 8, (_autoTune.running()) ? "Auto-Tune ..." : projector.config().name);
+  char buffer[FPS_NAME_LENGTH + 4];
   strcpy(buffer, (_isLoop) ? "Loop 000" : "Film 000");
   ui.insertPaddedInt(&buffer[5], _trackNum, 10, 3);
   ui.drawRightAlignedStr(8, buffer);
-  itoa(_fps, buffer, 10);
-  strcat(buffer, " fps");
+  uint8_t n = strlen(_filename) - 8 - 2 * _isLoop;     // "23.976" of "001-23.976-L.ogg"
+  memcpy(buffer, &_filename[4], n);
+  strcpy(&buffer[n], " fps");
   ui.drawRightAlignedStr(62, buffer);
   u8g2->setFont(FONT10);
 }
 
 void Audio::drawPlayingMenuStatus() {
-  if (paused())
+  if (_playMode & PLAYMODE_PAUSE_ON)
     u8g2->drawXBMP(60, 54, pause_xbm_width, pause_xbm_height, pause_xbm_bits);
   else
     u8g2->drawXBMP(60, 54, play_xbm_width, play_xbm_height, play_xbm_bits);
 }
 
 void Audio::drawWaitForPlayingMenu() {
+  PROFILE_SCOPE(PROFILE_DISPLAY);
   u8g2->clearBuffer();
   drawPlayingMenuConstants();
   ui.drawCenteredStr(28, "Waiting for");
   ui.drawCenteredStr(46, "Film to Start");
   drawPlayingMenuStatus();
-  u8g2->sendBuffer();
+  sendBuffer();
 }
 
 void Audio::drawPlayingMenu() {
@@ -417,13 +1103,14 @@ void Audio::drawPlayingMenu() {
   if ((currentMillis-prevMillis) < 40)
     return;
   prevMillis = currentMillis;
+  PROFILE_SCOPE(PROFILE_DISPLAY);
 
   // clear screen buffer & draw constants
   u8g2->clearBuffer();
   drawPlayingMenuConstants();
 
   // draw time-code
-  uint32_t audioSecs = (totalImpCounter + syncOffsetImps) / impToAudioSecondsDivider;
+  uint32_t audioSecs = impsToSamples(totalImpCounter + syncOffsetImps) / _fsPhysical;
   uint8_t hh = numberOfHours(audioSecs);
   uint8_t mm = numberOfMinutes(audioSecs);
   uint8_t ss = numberOfSeconds(audioSecs);
@@ -453,7 +1140,7 @@ void Audio::drawPlayingMenu() {
       u8g2->print("+");
     u8g2->print(_frameOffset);
   }
-  u8g2->sendBuffer();
+  sendBuffer();
 }
 
 
@@ -474,6 +1161,7 @@ void Audio::handleFrameCorrectionOffsetInput() {
   if ((currentMillis-prevMillis) < 40)
     return;
   prevMillis = currentMillis;
+  PROFILE_SCOPE(PROFILE_DISPLAY);
 
   EEPROMstruct pConf = projector.config();
   int32_t newSyncOffset = enc.getValue();
@@ -509,31 +1197,56 @@ void Audio::handleFrameCorrectionOffsetInput() {
     u8g2->setCursor(25, 46);
   u8g2->print(newSyncOffset);
 
-  u8g2->sendBuffer();
+  sendBuffer();
   u8g2->setFont(FONT10);
 }
 
-int32_t Audio::average(int32_t input) {
-  static const uint16_t n = PID_FILTER_N;
-  static int32_t readings[n] = {0};
-  static int64_t total = 0;
-  static uint32_t readIdx = 0;
-  readIdx = (readIdx + 1) % (n);              // update array index
-  total = total - readings[readIdx];          // subtract previous reading from running total
-  readings[readIdx] = input;                  // store new reading to array
-  total += input;                             // add new reading to running total
-  return total / n;                           // calculate & return the average
+bool Audio::loadTrack(uint16_t trackNum) {
+  // Look the track up in the table of tracks. It is rebuilt after the card
+  // has been out and once if the track is missing: it might have been copied
+  // via MTP since.
+  bool scanned = _cardRemoved || !_tracks.valid();
+  if (scanned)
+    scanTracks();
+  char fps[FPS_NAME_LENGTH];
+  bool isLoop;
+  bool found = _tracks.find(trackNum, fps, &isLoop);
+  if (!found && !scanned) {
+    scanTracks();
+    found = _tracks.find(trackNum, fps, &isLoop);
+  }
+  if (!found)
+    return !_tracks.complete() && probeTrack(trackNum);   // not all tracks in table
+  strcpy(_filename, "000-");
+  ui.insertPaddedInt(&_filename[0], trackNum, 10, 3);
+  strcat(_filename, fps);
+  strcat(_filename, (isLoop) ? "-L.ogg" : ".ogg");
+  TrackDirectory::rate(fps, &_fps);
+  _trackNum = trackNum;
+  _isLoop = isLoop;
+  _indexed = false;
+  return true;
 }
 
-bool Audio::loadTrack(uint16_t trackNum) {
+void Audio::scanTracks() {
+  if (_cardRemoved) {                                   // maybe a different card
+    _cardRemoved = false;
+    SD.begin(VS1053_SDCS);
+  }
+  _tracks.scan();
+  PRINTF("%u tracks on SD card\n", _tracks.count());
+}
+
+bool Audio::probeTrack(uint16_t trackNum) {
   for (bool isLoop : { false, true })  {
     strcpy(_filename, (isLoop) ? "000-00-L.ogg" : "000-00.ogg");
     ui.insertPaddedInt(&_filename[0], trackNum, 10, 3);
-    for (_fps=12; _fps<=25; _fps++) {                             // guess fps
-      ui.insertPaddedInt(&_filename[4], _fps, 10, 2);
+    for (_fps.num=12, _fps.den=1; _fps.num<=25; _fps.num++) {     // guess fps (whole ones only)
+      ui.insertPaddedInt(&_filename[4], _fps.num, 10, 2);
       if (SD.exists(_filename)) {                                 // file found!
         _trackNum = trackNum;
         _isLoop = isLoop;
+        _indexed = false;
         return true;
       }
     }
@@ -546,6 +1259,7 @@ uint16_t Audio::selectTrackScreen() {
   bool first = true;
   enc.setValue((trackNum > 0) ? trackNum : 1);
   enc.setLimits(0,999);
+  enc.setAcceleration(true);                            // track 999 with a flick
   while (enc.getButton()) {
     yield();
     if (enc.valueChanged() || first) {
@@ -566,6 +1280,7 @@ uint16_t Audio::selectTrackScreen() {
       u8g2->sendBuffer();
     }
   }
+  enc.setAcceleration(false);
   enc.setLimits(-999,999);
   enc.setValue(0);
   u8g2->setFont(FONT10);
@@ -573,6 +1288,48 @@ uint16_t Audio::selectTrackScreen() {
   return trackNum;
 }
 
+uint32_t Audio::startFrameScreen() {
+  // timecode of the frame in the gate
+  uint8_t mm = 0, ss = 0, ff = 0;
+  ui.reverseEncoder(true);
+  uint32_t mmMax = (_indexed) ? _index.samples / _index.fs / SECS_PER_MIN : 99;
+  if (mmMax > 99)
+    mmMax = 99;
+  u8g2->userInterfaceInputValue("Start at Minute:", "", &mm, 0, mmMax, 2, " min");
+  u8g2->userInterfaceInputValue("Start at Second:", "", &ss, 0, 59, 2, " s");
+  u8g2->userInterfaceInputValue("Start at Frame:", "", &ff, 0, (_fps.num - 1) / _fps.den, 2, "");
+  ui.reverseEncoder(false);
+  return ((uint32_t) mm * SECS_PER_MIN + ss) * _fps.num / _fps.den + ff;
+}
+
+bool Audio::indexTrack() {
+  // The sidecar file next to the track lists the page holding each second of
+  // audio, so seeking takes a single read. It takes one pass over the track,
+  // so it is built after the track has been played (seeks bisect until then)
+  // and rebuilt if the track has changed since.
+  File track = SD.open(_filename);
+  if (!track)
+    return false;
+  _indexed = readIndex(&track);
+#if !defined(__MKL26Z64__)                      // Teensy LC: bisect instead
+  if (!_indexed) {
+    PRINTLN("Indexing track ...");
+    u8g2->clearBuffer();
+    u8g2->setFont(FONT10);
+    u8g2->drawStr(8,50,"Indexing...");
+    PeriodicTimer beeTimer(TCK);
+    beeTimer.begin([]() { ui.drawBusyBee(90, 10); }, 30_Hz);
+    _indexed = writeIndex(&track);
+    beeTimer.stop();
+  }
+#endif
+  track.close();
+  if (_indexed) {
+    PRINTF("Duration: %lu s, %lu index entries\n", _index.samples / _index.fs, _index.entries);
+  }
+  return _indexed;
+}
+
 bool Audio::connected() {
   // test if audio device is plugged into 3.5mm jack
   pinMode(PIN_TIPSW, OUTPUT);
@@ -647,23 +1404,33 @@ bool Audio::loadPatch() {
 void Audio::enableResampler(bool enable) {
   // See section 1.6 of
   // https://www.vlsi.fi/fileadmin/software/VS10XX/vs1053b-patches.pdf
-  if (enable) {
-    sciWriteWRAM16(0x1e09, 0x0080);
-    PRINTLN("15/16 Resampler enabled.");
-  } else {
-    sciWriteWRAM16(0x1e09, 0x0000);
-    PRINTLN("15/16 Resampler disabled.");
-  }
+  setPlayMode(PLAYMODE_RESAMPLER_ON, enable);
+  PRINTLN((enable) ? "15/16 Resampler enabled." : "15/16 Resampler disabled.");
+}
+
+void Audio::holdDecoder(bool hold) {
+  // pause mode of the patches: the decoder stops taking data from the stream
+  // buffer, which can still be filled via SDI
+  setPlayMode(PLAYMODE_PAUSE_ON, hold);
+}
+
+void Audio::setPlayMode(uint16_t bits, bool set) {
+  _playMode = (set) ? _playMode | bits : _playMode & ~bits;
+  sciWriteWRAM16(VS1053_XMEM_PLAYMODE, _playMode);
 }
 
 void Audio::adjustSamplerate(int32_t ppm2) {
+  // AUDATA is rewritten from its shadow instead of being read back
+  sci.beginBurst();
   sciWriteWRAM32(0x1e07, ppm2);
   sciWriteWRAM16(0x5b1c, 0);
-  sciWrite(VS1053_REG_AUDATA, sciRead(VS1053_REG_AUDATA));
+  sci.write(VS1053_REG_AUDATA, _audata);
+  sci.endBurst();
 }
 
 uint16_t Audio::getSamplingRate() {
-  uint16_t sr = sciRead(VS1053_REG_AUDATA) & 0xfffe;  // Mask the Mono/Stereo Bit
+  _audata = sci.read(VS1053_REG_AUDATA);
+  uint16_t sr = _audata & 0xfffe;                     // Mask the Mono/Stereo Bit
   return (sr == 11024) ? 11025 : sr;                  // return (corrected) sample rate
 }
 
@@ -671,6 +1438,19 @@ uint32_t Audio::getSampleCount() {
   return sciReadWRAM32Counter(VS1053_XMEM_SAMPLECOUNT);
 }
 
+uint32_t Audio::getHeardSampleCount(int16_t *audioFill) {
+  // SAMPLECOUNT counts decoded samples. Those still queued in the audio
+  // buffer (stereo pairs, whatever the track) and in the DAC's filters
+  // haven't been heard yet. The buffer's fill level changes with the
+  // decoder's load and the playback rate, so it's read along with the
+  // counter.
+  sci.beginBurst();
+  uint32_t count = getSampleCount();
+  *audioFill = AudioBufferFillWords();
+  sci.endBurst();
+  return count - *audioFill / 2 - DAC_LATENCY_SAMPLES;
+}
+
 uint32_t Audio::getAudioMillis() {
   return sciReadWRAM32Counter(VS1053_XMEM_POSITIONMSEC_0);
 }
@@ -679,16 +1459,13 @@ void Audio::clearSampleCounter() {
   sciWriteWRAM32(VS1053_XMEM_SAMPLECOUNT,0);
 }
 
-void Audio::restoreSampleCounter(uint32_t samplecounter) {
-  sciWriteWRAM32(VS1053_XMEM_SAMPLECOUNT, samplecounter);
-}
 
 void Audio::clearErrorCounter() {
   sciWriteWRAM16(0x5a82, 0);
 }
 
 uint16_t Audio::getBitrate() {
-  return sciRead(VS1053_REG_HDAT0) << 3;
+  return sci.read(VS1053_REG_HDAT0) << 3;
 }
 
 const char Audio::getRevision() {
@@ -701,100 +1478,187 @@ const char Audio::getRevision() {
 }
 
 bool Audio::isOgg() {
-  return sciRead(VS1053_REG_HDAT1) == 0x4F67;
+  _hdat1 = sci.read(VS1053_REG_HDAT1);
+  return _hdat1 == 0x4F67;
+}
+
+size_t Audio::firstAudioPage(File *file) {
+  // audio starts after the last header page (granule position 0), pages
+  // without a granule position may follow that
+  OggWalker ogg(file);
+  size_t pos = UINT32_MAX;
+  for (bool ok = ogg.read(0); ok && ogg.granulePos() <= 0; ok = ogg.next())
+    if (ogg.granulePos() == 0)
+      pos = ogg.nextPosition();
+  return pos;
+}
+
+void Audio::sidecarName(char *name, const char *ext) {
+  // "001-24.ogg" -> "001-24.idx"
+  strcpy(name, _filename);
+  strcpy(strrchr(name, '.'), ext);
+}
+
+uint32_t Audio::modifiedStamp(File *file) {
+  DateTimeFields tm;
+  if (!file->getModifyTime(tm))
+    return 0;
+  return (uint32_t) ((tm.year - 80) << 9 | (tm.mon + 1) << 5 | tm.mday) << 16 |
+    (tm.hour << 11 | tm.min << 5 | tm.sec / 2);
 }
 
-size_t Audio::findInFile(File *file, const char *target, uint8_t length, size_t startPos) {
-  char buf[length];
-  for (uint64_t i = startPos; i <= file->size() - length; i++) {
-    file->seek(i);
-    file->read(buf, length);
-    if (!strncmp(buf, target, length)) {
-      file->seek(i);
-      return file->position();
+bool Audio::readIndex(File *track) {
+  // header only, valid if it matches the track
+  char name[sizeof(_filename)];
+  sidecarName(name, ".idx");
+  File file = SD.open(name);
+  if (!file)
+    return false;
+  bool valid = file.read(&_index, sizeof(_index)) == sizeof(_index) &&
+    !strncmp(_index.magic, "SKIX", 4) && _index.version == INDEX_VERSION &&
+    _index.fileSize == track->size() && _index.modified == modifiedStamp(track) &&
+    file.size() == sizeof(_index) + _index.entries * 2 * sizeof(uint32_t);
+  file.close();
+  return valid;
+}
+
+bool Audio::writeIndex(File *track) {
+  char name[sizeof(_filename)];
+  sidecarName(name, ".idx");
+  memcpy(_index.magic, "SKIX", 4);
+  _index.version    = INDEX_VERSION;
+  _index.fileSize   = track->size();
+  _index.modified   = modifiedStamp(track);
+  vorbisID id;
+  _index.fs         = (readVorbisID(track, &id)) ? id.fs : 0;
+  _index.audioStart = firstAudioPage(track);
+  _index.stride     = _index.fs;                    // one entry per second
+  _index.entries    = 0;
+  if (!_index.fs || _index.audioStart == UINT32_MAX)
+    return false;
+  SD.remove(name);
+  File file = SD.open(name, FILE_WRITE);
+  if (!file)
+    return false;
+  bool ok = file.write(&_index, sizeof(_index)) == sizeof(_index);  // placeholder, completed below
+
+  // entry i: the first page of the range ending at or after sample i * stride
+  OggWalker ogg(track);
+  uint32_t entry[2] = {_index.audioStart, 0};       // position, granule position before
+  for (bool page = ogg.read(_index.audioStart); page && ok; page = ogg.next()) {
+    int64_t granule = ogg.granulePos();
+    if (granule < 0)                                // no packet ends on this page
+      continue;
+    while (ok && (int64_t) _index.entries * _index.stride <= granule) {
+      ok = file.write(entry, sizeof(entry)) == sizeof(entry);
+      _index.entries++;
     }
+    entry[0] = ogg.nextPosition();
+    entry[1] = granule;
+    yield();                                        // busy bee
   }
-  return UINT32_MAX;
+  ok = ok && ogg.nextPosition() == track->size();  // walked up to the end, no broken page
+  _index.samples = entry[1];
+  ok = ok && file.seek(0) && file.write(&_index, sizeof(_index)) == sizeof(_index);
+  file.close();
+  if (!ok)
+    SD.remove(name);
+  return ok;
 }
 
-size_t Audio::firstAudioPage(File *file) {
-  const char vorbisID[7] = {5, 'v', 'o', 'r', 'b', 'i', 's'}; // search-string for Vorbis setup header
-  size_t pos = findInFile(file, vorbisID, 7, 0);              // find position of Vorbis setup header
-  return findInFile(file, "OggS", 4, pos);                    // audio starts on the next Ogg page
+bool Audio::indexLookup(int64_t target, size_t *pos, int64_t *granule) {
+  // entry of the second holding the target: the page walk starts there
+  char name[sizeof(_filename)];
+  sidecarName(name, ".idx");
+  uint32_t i = target / _index.stride, entry[2] = {0, 0};
+  if (i >= _index.entries)                          // not in the index
+    return false;
+  File file = SD.open(name);
+  bool ok = file && file.seek(sizeof(_index) + i * sizeof(entry)) &&
+    file.read(entry, sizeof(entry)) == sizeof(entry);
+  file.close();
+  if (ok) {
+    *pos     = entry[0];
+    *granule = entry[1];
+  }
+  return ok;
 }
 
-int64_t Audio::granulePos(oggPage *og) {
-  unsigned char *page = og->header;
-  int64_t granulepos = page[13] & (0xff);
-  granulepos = (granulepos << 8) | (page[12] & 0xff);
-  granulepos = (granulepos << 8) | (page[11] & 0xff);
-  granulepos = (granulepos << 8) | (page[10] & 0xff);
-  granulepos = (granulepos << 8) | (page[ 9] & 0xff);
-  granulepos = (granulepos << 8) | (page[ 8] & 0xff);
-  granulepos = (granulepos << 8) | (page[ 7] & 0xff);
-  granulepos = (granulepos << 8) | (page[ 6] & 0xff);
-  return (granulepos);
+bool Audio::readVorbisID(File *file, vorbisID *id) {
+  // identification header, the first packet of the stream (Vorbis I
+  // specification, section 4.2.2)
+  OggWalker ogg(file);
+  uint8_t h[30];
+  if (!ogg.read(0) || file->read(h, 30) != 30 || h[0] != 1 || memcmp(&h[1], "vorbis", 6) ||
+      h[7] | h[8] | h[9] | h[10] || !(h[29] & 1))           // version 0, framing bit
+    return false;
+  int32_t nominal = h[20] | (h[21] << 8) | ((uint32_t) h[22] << 16) | ((uint32_t) h[23] << 24);
+  id->channels = h[11];
+  id->fs       = h[12] | (h[13] << 8) | ((uint32_t) h[14] << 16) | ((uint32_t) h[15] << 24);
+  id->bitrate  = (nominal > 0) ? nominal : 0;
+  return id->channels && id->fs;
 }
 
 uint16_t Audio::sciReadWRAM16(uint16_t addr) {
-  sciWrite(VS1053_REG_WRAMADDR, addr);
-  return sciRead(VS1053_REG_WRAM);
+  uint16_t data;
+  sci.readWRAM(addr, &data, 1);
+  return data;
 }
 
 uint32_t Audio::sciReadWRAM32(uint16_t addr) {
-  sciWrite(VS1053_REG_WRAMADDR, addr);
-  uint16_t lsb = sciRead(VS1053_REG_WRAM);
-  return lsb | ((uint32_t)sciRead(VS1053_REG_WRAM) << 16);
+  uint16_t data[2];
+  sci.readWRAM(addr, data, 2);
+  return data[0] | ((uint32_t)data[1] << 16);
 }
 
 uint32_t Audio::sciReadWRAM32Counter(uint16_t addr) {
   // See section 1.3 of
   // https://www.vlsi.fi/fileadmin/software/VS10XX/vs1053b-patches.pdf
-  uint16_t msbV1, lsb, msbV2;
-  sciWrite(VS1053_REG_WRAMADDR, addr + 1);
-  msbV1 = (uint16_t)sciRead(VS1053_REG_WRAM);
-  sciWrite(VS1053_REG_WRAMADDR, addr);
-  lsb = (u_int32_t)sciRead(VS1053_REG_WRAM);
-  msbV2 = (uint16_t)sciRead(VS1053_REG_WRAM);
-  if (lsb < 0x8000U) {
-    msbV1 = msbV2;
+  uint16_t msbV1, data[2];
+  sci.beginBurst();
+  sci.readWRAM(addr + 1, &msbV1, 1);
+  sci.readWRAM(addr, data, 2);                        // lsb, msbV2
+  sci.endBurst();
+  if (data[0] < 0x8000U) {
+    msbV1 = data[1];
   }
-  return ((u_int32_t)msbV1 << 16) | lsb;
+  return ((u_int32_t)msbV1 << 16) | data[0];
 }
 
 void Audio::sciWriteWRAM16(uint16_t addr, uint16_t data) {
-  sciWrite(VS1053_REG_WRAMADDR, addr);
-  sciWrite(VS1053_REG_WRAM, data);
+  sci.writeWRAM(addr, &data, 1);
 }
 
 void Audio::sciWriteWRAM32(uint16_t addr, uint32_t data) {
-  sciWrite(VS1053_REG_WRAMADDR, addr);
-  sciWrite(VS1053_REG_WRAM, (uint16_t)data);
-  sciWrite(VS1053_REG_WRAM, (uint16_t)(data >> 16));
+  uint16_t words[2] = {(uint16_t)data, (uint16_t)(data >> 16)};
+  sci.writeWRAM(addr, words, 2);
+}
+
+int16_t Audio::StreamBufferSizeWords(void) {
+  return (_hdat1 == 0x664C) ? 0x1800 : 0x400;         // FLAC : others
 }
 
 int16_t Audio::StreamBufferFillWords(void) {
-  int16_t bufSize = (sciRead(VS1053_REG_HDAT1) == 0x664C) ? 0x1800 : 0x400;
-  uint16_t wrp = sciReadWRAM16(0x5A7D);
-  uint16_t rdp = sciRead(VS1053_REG_WRAM);
-  int16_t res = wrp - rdp;
+  int16_t bufSize = StreamBufferSizeWords();
+  uint16_t p[2];
+  sci.readWRAM(0x5A7D, p, 2);                         // wrp, rdp
+  int16_t res = p[0] - p[1];
   if (res < 0)
     return res + bufSize;
   return res;
 }
 
 int16_t Audio::StreamBufferFreeWords(void) {
-  int16_t bufSize = (sciRead(VS1053_REG_HDAT1) == 0x664C) ? 0x1800 : 0x400;
-  int16_t res = bufSize - StreamBufferFillWords();
+  int16_t res = StreamBufferSizeWords() - StreamBufferFillWords();
   if (res < 2)
     return 0;
   return res - 2;
 }
 
 int16_t Audio::AudioBufferFillWords(void) {
-  uint16_t wrp = sciReadWRAM16(0x5A80);
-  uint16_t rdp = sciRead(VS1053_REG_WRAM);
-  return (wrp - rdp) & 4095;
+  uint16_t p[2];
+  sci.readWRAM(0x5A80, p, 2);                         // wrp, rdp
+  return (p[0] - p[1]) & 4095;
 }
 
 int16_t Audio::AudioBufferFreeWords(void) {
@@ -0,0 +1,120 @@
+#include "autotune.h"
+#include "serialdebug.h"
+
+void AutoTune::begin(uint32_t tickMicros, float lockBand) {
+  *this = AutoTune();
+  _tick     = tickMicros / 1E6f;
+  _lockBand = lockBand;
+  _phase    = SETTLE;
+  PRINTLN("Auto-tune: waiting for lock ...");
+}
+
+float AutoTune::relay(float input, float pid) {
+  _ticks++;
+  if (_ticks > AUTOTUNE_TIMEOUT_TICKS && running()) {
+    PRINTLN("Auto-tune: no steady oscillation, giving up.");
+    _phase = FAILED;
+  }
+  if (_phase == SETTLE) {
+    // The PID stays in charge until the sync error has been within the lock
+    // band for a while. Meanwhile, its noise is measured: the spread of its
+    // changes from tick to tick, without the drift.
+    if (fabsf(input) > _lockBand) {
+      _settled = 0;
+      _sum = _sumSquares = 0;
+    } else if (_settled++ > 0) {
+      float diff   = input - _previous;
+      _sum        += diff;
+      _sumSquares += diff * diff;
+    }
+    _previous = input;
+    if (_settled < AUTOTUNE_SETTLE_TICKS)
+      return pid;
+    uint16_t n = _settled - 1;
+    float mean     = _sum / n;
+    float variance = _sumSquares / n - mean * mean;
+    hysteresis = 2 * sqrtf((variance > 0) ? variance : 0);
+    if (hysteresis < AUTOTUNE_MIN_HYSTERESIS)
+      hysteresis = AUTOTUNE_MIN_HYSTERESIS;
+    _phase    = RELAY;
+    _output   = (input > 0) ? -AUTOTUNE_RELAY_PPM2 : AUTOTUNE_RELAY_PPM2;
+    _switched = -1;
+    _max = _min = input;
+    PRINT("Auto-tune: relay on, band +/- ");
+    PRINT(hysteresis);
+    PRINTLN(" samples");
+    return _output;
+  }
+  if (_phase != RELAY)
+    return pid;
+
+  if (input > _max) _max = input;
+  if (input < _min) _min = input;
+  _outputSum += _output;
+  _cycleTicks++;
+  if (_output > 0 && input > hysteresis) {
+    // audio ahead: slow down. A cycle runs from one such switch to the next,
+    // the time of the crossing is interpolated between ticks.
+    float t = _ticks - (input - hysteresis) / (input - _previous);
+    if (_switched >= 0) {
+      if (_cycles >= AUTOTUNE_DISCARD) {
+        _periods    += t - _switched;
+        _amplitudes += (_max - _min) / 2;
+        _bias       += _outputSum / _cycleTicks / AUTOTUNE_CYCLES;
+      }
+      _cycles++;
+    }
+    _switched   = t;
+    _max = _min = input;
+    _outputSum  = 0;
+    _cycleTicks = 0;
+    _output     = -AUTOTUNE_RELAY_PPM2;
+    if (_cycles == AUTOTUNE_DISCARD + AUTOTUNE_CYCLES)
+      finish();
+  } else if (_output < 0 && input < -hysteresis)
+    _output = AUTOTUNE_RELAY_PPM2;
+  _previous = input;
+  return _output;
+}
+
+void AutoTune::cancel() {
+  if (!running())
+    return;
+  PRINTLN("Auto-tune: cancelled.");
+  _phase = FAILED;
+}
+
+void AutoTune::finish() {
+  float amplitude = _amplitudes / AUTOTUNE_CYCLES;
+  if (amplitude <= hysteresis) {
+    PRINTLN("Auto-tune: oscillation lost in noise, giving up.");
+    _phase = FAILED;
+    return;
+  }
+  // describing function of a relay with hysteresis
+  ku = 4 * AUTOTUNE_RELAY_PPM2 / (PI * sqrtf(amplitude * amplitude - hysteresis * hysteresis));
+  tu = _periods / AUTOTUNE_CYCLES * _tick;
+
+  // Ziegler-Nichols for PI: Kp = 0.45 Ku, Ti = Tu / 1.2. Derivative action
+  // only passes the projector's speed noise on to the playback speed.
+  float kp = 0.45f * ku;
+  p = gain(kp);
+  i = gain(kp * 1.2f / tu);
+  d = 0;
+  _phase = DONE;
+  print();
+}
+
+uint16_t AutoTune::gain(float g) {
+  return (g < 0) ? 0 : (g > 99.99f) ? 9999 : (uint16_t) lroundf(g * 100);
+}
+
+void AutoTune::print() const {
+  PRINT("Auto-tune: Ku ");
+  PRINT(ku);
+  PRINT(" ppm2/sample, Tu ");
+  PRINT(tu);
+  PRINT(" s, bias ");
+  PRINT(_bias, 0);
+  PRINTF(" ppm2 -> P %u.%02u, I %u.%02u, D %u.%02u\n", p / 100, p % 100, i / 100, i % 100, d / 100, d % 100);
+}
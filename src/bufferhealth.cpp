@@ -0,0 +1,93 @@
+#include "bufferhealth.h"
+#include "serialdebug.h"
+#include "ui.h"
+
+void BufferHealth::Level::clear() {
+  now = 0;
+  lowest  = 100;
+  highest = 0;
+  memset(histogram, 0, sizeof(histogram));
+}
+
+void BufferHealth::Level::add(uint16_t fill, uint16_t capacity) {
+  if (capacity == 0)
+    return;
+  if (fill > capacity)
+    fill = capacity;
+  now = (uint32_t) fill * 100 / capacity;
+  if (now < lowest)  lowest  = now;
+  if (now > highest) highest = now;
+  uint8_t bin = (uint32_t) fill * HEALTH_BINS / capacity;
+  histogram[(bin < HEALTH_BINS) ? bin : HEALTH_BINS - 1]++;   // full counts into the top bin
+}
+
+void BufferHealth::clear() {
+  readAhead.clear();
+  stream.clear();
+  audio.clear();
+  ticks          = 0;
+  underflows     = 0;
+  underflowTicks = 0;
+  last.atMillis  = 0;
+  _startMillis   = millis();
+}
+
+void BufferHealth::tick(uint16_t n) {
+  ticks++;
+  if (!n)
+    return;
+  underflows += n;
+  underflowTicks++;
+  last.atMillis  = millis() - _startMillis;
+  last.readAhead = readAhead.now;
+  last.stream    = stream.now;
+  last.audio     = audio.now;
+  PRINTF("Buffer underflow at %lu ms (read-ahead %u%%, stream %u%%, audio %u%%)\n",
+    last.atMillis, last.readAhead, last.stream, last.audio);
+}
+
+void BufferHealth::print() const {
+  PRINTF("Buffer health over %lu ticks: %lu underflows in %lu ticks\n", ticks, underflows, underflowTicks);
+#if defined(MYSERIAL)
+  auto printLevel = [](const char *name, const Level &l) {
+    PRINTF("  %-10s min %3u%%, max %3u%%, histogram", name, l.lowest, l.highest);
+    for (uint8_t i = 0; i < HEALTH_BINS; i++)
+      PRINTF(" %lu", l.histogram[i]);
+    PRINTLN();
+  };
+  printLevel("read-ahead", readAhead);
+  printLevel("stream", stream);
+  printLevel("audio", audio);
+#endif
+}
+
+void BufferHealth::show() const {
+  // three histograms side by side, each bin scaled to the fullest one
+  auto drawLevel = [](u8g2_uint_t x, const char *name, const Level &l) {
+    uint32_t peak = 1;
+    for (uint8_t i = 0; i < HEALTH_BINS; i++)
+      if (l.histogram[i] > peak)
+        peak = l.histogram[i];
+    for (uint8_t i = 0; i < HEALTH_BINS; i++) {
+      u8g2_uint_t h = (l.histogram[i] * 34 + peak - 1) / peak;
+      u8g2->drawBox(x + i * 5, 52 - h, 4, h);
+    }
+    u8g2->drawHLine(x, 53, HEALTH_BINS * 5 - 1);
+    u8g2->drawStr(x, 63, name);
+  };
+
+  char buffer[24];
+  u8g2->clearBuffer();
+  u8g2->setFont(FONT08);
+  snprintf(buffer, sizeof(buffer), "Underflows: %lu", (unsigned long) underflows);
+  ui.drawCenteredStr(8, buffer);
+  drawLevel( 0, "RAM",    readAhead);
+  drawLevel(44, "Stream", stream);
+  drawLevel(88, "Audio",  audio);
+  u8g2->sendBuffer();
+  u8g2->setFont(FONT10);
+
+  while (enc.getButton())
+    yield();
+  ui.waitForBttnRelease();
+}
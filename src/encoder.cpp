@@ -0,0 +1,140 @@
+#include "encoder.h"
+#include "profiler.h"
+
+static RotaryEncoder *instance = nullptr;
+
+// quadrature transitions, indexed by previous and current state of A and B:
+// +1 / -1 for a step, 0 for none or an invalid one (both changed)
+static const int8_t transitions[16] = { 0, -1,  1,  0,
+                                        1,  0,  0, -1,
+                                       -1,  0,  0,  1,
+                                        0,  1, -1,  0 };
+
+void RotaryEncoder::begin(uint8_t pinA, uint8_t pinB, uint8_t pinButton) {
+  instance   = this;
+  _pinA      = pinA;
+  _pinB      = pinB;
+  _pinButton = pinButton;
+  pinMode(_pinA, INPUT_PULLUP);
+  pinMode(_pinB, INPUT_PULLUP);
+  pinMode(_pinButton, INPUT_PULLUP);
+  _state  = digitalReadFast(_pinA) << 1 | digitalReadFast(_pinB);
+  _button = digitalReadFast(_pinButton);
+  _event.attach(dispatch);                        // callbacks from yield()
+  attachInterrupt(digitalPinToInterrupt(_pinA), isrAB, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(_pinB), isrAB, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(_pinButton), isrButton, CHANGE);
+}
+
+void RotaryEncoder::setValue(int32_t value) {
+  noInterrupts();
+  _value = constrain(value, _min, _max);
+  interrupts();
+}
+
+void RotaryEncoder::setLimits(int32_t min, int32_t max) {
+  _min = min;
+  _max = max;
+  setValue(_value);
+}
+
+bool RotaryEncoder::valueChanged() {
+  noInterrupts();
+  bool changed = _changed;
+  _changed = false;
+  interrupts();
+  return changed;
+}
+
+bool RotaryEncoder::getButton() {
+  // an edge lost amid bouncing is made up for once the level has settled
+  noInterrupts();
+  bool level = digitalReadFast(_pinButton);
+  if (level != _button && micros() - _buttonEdge >= ENC_DEBOUNCE_US) {
+    _button = level;
+    _buttonChanged = true;
+  }
+  interrupts();
+  return _button;
+}
+
+bool RotaryEncoder::buttonChanged() {
+  getButton();
+  noInterrupts();
+  bool changed = _buttonChanged;
+  _buttonChanged = false;
+  interrupts();
+  return changed;
+}
+
+void RotaryEncoder::isrAB() {
+  PROFILE_SCOPE(PROFILE_ENCODER);
+  RotaryEncoder *e = instance;
+  uint8_t state = digitalReadFast(e->_pinA) << 1 | digitalReadFast(e->_pinB);
+  e->_steps += transitions[e->_state << 2 | state];
+  e->_state  = state;
+  if (state != 0b00 && state != 0b11)
+    return;
+  // at a detent: a bounce back and forth adds up to nothing
+  if (e->_steps >= 2)
+    e->count(1);
+  else if (e->_steps <= -2)
+    e->count(-1);
+  e->_steps = 0;
+}
+
+void RotaryEncoder::count(int8_t direction) {
+  uint32_t now = micros();
+  uint32_t interval = now - _lastCount;
+  _lastCount = now;
+  if (direction != _direction || interval > ENC_ACCEL_PAUSE_US)
+    _interval = ENC_ACCEL_PAUSE_US;               // a new turn starts slowly
+  else
+    _interval += ((int32_t) interval - (int32_t) _interval) / 4;
+  _direction = direction;
+
+  int32_t step = 1;
+  uint32_t rate = 1000000 / (_interval + 1);      // [counts/s]
+  if (_accelerate && rate > ENC_ACCEL_RATE) {
+    uint32_t excess = rate - ENC_ACCEL_RATE;
+    step = (excess < 1000) ? 1 + excess * excess / ENC_ACCEL_DIV : ENC_ACCEL_MAX;
+    if (step > ENC_ACCEL_MAX)
+      step = ENC_ACCEL_MAX;
+  }
+
+  int32_t value = constrain(_value + direction * step, _min, _max);
+  if (value == _value)
+    return;
+  _delta  += value - _value;
+  _value   = value;
+  _changed = true;
+  _event.triggerEvent();
+}
+
+void RotaryEncoder::isrButton() {
+  PROFILE_SCOPE(PROFILE_ENCODER);
+  RotaryEncoder *e = instance;
+  uint32_t now = micros();
+  if (now - e->_buttonEdge < ENC_DEBOUNCE_US)    // bouncing
+    return;
+  e->_buttonEdge    = now;
+  e->_button        = digitalReadFast(e->_pinButton);
+  e->_buttonChanged = true;
+  e->_buttonEvent   = true;
+  e->_event.triggerEvent();
+}
+
+void RotaryEncoder::dispatch(EventResponderRef) {
+  PROFILE_SCOPE(PROFILE_ENCODER);
+  RotaryEncoder *e = instance;
+  noInterrupts();
+  int32_t delta = e->_delta;
+  bool button   = e->_buttonEvent;
+  e->_delta       = 0;
+  e->_buttonEvent = false;
+  interrupts();
+  if (delta && e->_callback)
+    e->_callback(e->_value, delta);
+  if (button && e->_buttonCallback)
+    e->_buttonCallback(e->_button);
+}
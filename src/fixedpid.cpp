@@ -0,0 +1,44 @@
+#include "fixedpid.h"
+
+void FixedPID::SetMode(Control mode) {
+  if (_mode == Control::manual && mode != Control::manual) {
+    // bumpless: carry on from the current output
+    _outputSum = constrain(*_output * (1L << FIXED_Q), _outMin, _outMax);
+    _lastInput = *_input;
+  }
+  _mode = mode;
+}
+
+void FixedPID::SetTunings(float kp, float ki, float kd) {
+  float s = _sampleTimeUs / 1E6f;
+  _kp = lroundf(kp * 65536);
+  _ki = lroundf(ki * s * 65536);
+  _kd = lroundf(kd / s * 65536);
+}
+
+void FixedPID::SetOutputLimits(int32_t min, int32_t max) {
+  _outMin = min * (1L << FIXED_Q);
+  _outMax = max * (1L << FIXED_Q);
+}
+
+bool FixedPID::Compute() {
+  if (_mode == Control::manual)
+    return false;
+  int32_t input  = *_input;
+  int32_t dInput = input - _lastInput;
+  _pTerm = -multiply(_kp, dInput);                  // on measurement
+  _iTerm =  multiply(_ki, *_setpoint - input);
+  _dTerm = -multiply(_kd, dInput);                  // on measurement
+  _outputSum = constrain(_outputSum + _iTerm + _pTerm, _outMin, _outMax);
+  int32_t output = constrain(_outputSum + _dTerm, _outMin, _outMax);
+  *_output = (output + (1L << (FIXED_Q - 1))) >> FIXED_Q;
+  _lastInput = input;
+  return true;
+}
+
+int32_t FixedPID::multiply(int32_t gain, int32_t value) {
+  // Q16 times Q8, rounded to Q8 - saturated, so the sums can't overflow
+  const int64_t limit = 1L << 29;
+  int64_t product = ((int64_t) gain * value + 32768) >> 16;
+  return (product > limit) ? limit : (product < -limit) ? -limit : product;
+}
@@ -0,0 +1,168 @@
+#include "impulse.h"
+#include "pins.h"
+#include "profiler.h"
+
+RingBuffer<uint32_t, IMPULSE_BUFFER_N> impulseBuffer;
+
+// Pin change interrupt ------------------------------------------------------
+
+void ImpulseInterrupt::begin() {
+  attachInterrupt(IMPULSE, isr, RISING);
+}
+
+void ImpulseInterrupt::end() {
+  detachInterrupt(IMPULSE);
+}
+
+void ImpulseInterrupt::isr() {
+  PROFILE_SCOPE(PROFILE_IMPULSE);
+  static unsigned long lastMicros = 0;
+  unsigned long thisMicros = micros();
+
+  if ((thisMicros - lastMicros) > IMPULSE_DEBOUNCE) { // poor man's debounce
+    impulseBuffer.push(thisMicros);               // lock-free, no need to mask interrupts
+    lastMicros = thisMicros;
+    digitalToggleFast(LED_BUILTIN);               // toggle the LED
+  }
+}
+
+// Timer input capture -------------------------------------------------------
+
+#if defined(IMPULSE_CAPTURE)
+
+#if defined(__MKL26Z64__) && IMPULSE == 2         // Teensy LC  [MKL26Z64]
+  #define CAPTURE_SC       FTM0_SC                // TPM0, named FTM0 by Teensyduino
+  #define CAPTURE_CNT      FTM0_CNT
+  #define CAPTURE_MOD      FTM0_MOD
+  #define CAPTURE_CSC      FTM0_C0SC
+  #define CAPTURE_CV       FTM0_C0V
+  #define CAPTURE_PCR      PORTD_PCR0
+  #define CAPTURE_MUX      4
+  #define CAPTURE_IRQ      IRQ_FTM0
+  #define CAPTURE_ISR      ftm0_isr
+  #define CAPTURE_CLOCK    (F_PLL / 2)            // TPMSRC = MCGPLLCLK/2
+  #define CAPTURE_ACK(reg, val, flag) reg = (val) // flags are cleared by writing 1
+#elif defined(__MK20DX256__) && IMPULSE == 3      // Teensy 3.2 [MK20DX256]
+  #define CAPTURE_SC       FTM1_SC
+  #define CAPTURE_CNT      FTM1_CNT
+  #define CAPTURE_MOD      FTM1_MOD
+  #define CAPTURE_CSC      FTM1_C0SC
+  #define CAPTURE_CV       FTM1_C0V
+  #define CAPTURE_PCR      PORTA_PCR12
+  #define CAPTURE_MUX      3
+  #define CAPTURE_IRQ      IRQ_FTM1
+  #define CAPTURE_ISR      ftm1_isr
+  #define CAPTURE_CLOCK    F_BUS
+  #define CAPTURE_ACK(reg, val, flag) reg = (val) & ~(flag) // flags are cleared by writing 0
+#else
+  #error "IMPULSE_CAPTURE: no timer channel available on the IMPULSE pin"
+#endif
+
+#define CAPTURE_PS         6                      // prescaler 2^6: 0.75 MHz at 48 MHz
+#define CAPTURE_PRIORITY   64                     // above DREQ (see Audio::begin)
+
+static volatile uint32_t captureOverflows = 0;
+
+static uint32_t captureMicros(uint32_t overflows, uint16_t value) {
+  uint64_t ticks = ((uint64_t) overflows << 16) | value;
+  return (ticks << CAPTURE_PS) / (CAPTURE_CLOCK / 1000000);
+}
+
+void ImpulseCapture::begin() {
+  CAPTURE_SC  = 0;                                // stop counter
+  CAPTURE_CNT = 0;
+  CAPTURE_MOD = 0xFFFF;                           // free running
+  CAPTURE_CSC = FTM_CSC_CHIE | FTM_CSC_ELSA;      // input capture on rising edge
+  captureOverflows = 0;
+  CAPTURE_SC  = FTM_SC_TOIE | FTM_SC_CLKS(1) | FTM_SC_PS(CAPTURE_PS);
+  CAPTURE_PCR = PORT_PCR_MUX(CAPTURE_MUX) | PORT_PCR_PE;  // keep pull-down
+  NVIC_SET_PRIORITY(CAPTURE_IRQ, CAPTURE_PRIORITY);
+  NVIC_ENABLE_IRQ(CAPTURE_IRQ);
+}
+
+void ImpulseCapture::end() {
+  NVIC_DISABLE_IRQ(CAPTURE_IRQ);
+  CAPTURE_SC  = 0;
+  CAPTURE_CSC = 0;
+  pinMode(IMPULSE, INPUT_PULLDOWN);               // back to GPIO
+}
+
+uint32_t ImpulseCapture::now() {
+  noInterrupts();
+  uint16_t value = CAPTURE_CNT;
+  uint32_t overflows = captureOverflows;
+  if ((CAPTURE_SC & FTM_SC_TOF) && value < 0x8000)  // see CAPTURE_ISR
+    overflows++;
+  interrupts();
+  return captureMicros(overflows, value);
+}
+
+void CAPTURE_ISR() {
+  PROFILE_SCOPE(PROFILE_IMPULSE);
+  static uint32_t lastMicros = 0;
+  uint32_t sc  = CAPTURE_SC;
+  uint32_t csc = CAPTURE_CSC;
+
+  if (csc & FTM_CSC_CHF) {
+    uint16_t value = CAPTURE_CV;
+    CAPTURE_ACK(CAPTURE_CSC, csc, FTM_CSC_CHF);
+
+    // an overflow that is still pending happened before the edge if the
+    // captured value is small
+    uint32_t overflows = captureOverflows;
+    if ((sc & FTM_SC_TOF) && value < 0x8000)
+      overflows++;
+    uint32_t thisMicros = captureMicros(overflows, value);
+
+    if ((thisMicros - lastMicros) > IMPULSE_DEBOUNCE) {
+      impulseBuffer.push(thisMicros);
+      lastMicros = thisMicros;
+      digitalToggleFast(LED_BUILTIN);
+    }
+  }
+
+  if (sc & FTM_SC_TOF) {
+    CAPTURE_ACK(CAPTURE_SC, sc, FTM_SC_TOF);
+    captureOverflows++;
+  }
+}
+
+#endif
+
+// Replay from file ----------------------------------------------------------
+
+void ImpulseReplay::begin() {
+  _file = SD.open(_filename);
+  _valid = _file && readNext();
+  _first = _next;
+  _started = false;
+}
+
+void ImpulseReplay::end() {
+  _file.close();
+  _valid = false;
+}
+
+void ImpulseReplay::poll() {
+  if (!_started) {                                // the recording starts at the start mark
+    if (digitalReadFast(STARTMARK))
+      return;
+    _started = true;
+    _startMicros = micros();
+  }
+
+  // timestamps are pushed from the main loop, so they are exact but may be
+  // drained a few loop iterations late
+  while (_valid && (micros() - _startMicros) >= (_next - _first)) {
+    impulseBuffer.push(_startMicros + (_next - _first));
+    _valid = readNext();
+  }
+}
+
+bool ImpulseReplay::readNext() {
+  uint8_t b[4];
+  if (_file.read(b, 4) != 4)
+    return false;
+  _next = b[0] | (b[1] << 8) | ((uint32_t) b[2] << 16) | ((uint32_t) b[3] << 24);
+  return true;
+}
@@ -10,14 +10,14 @@ char boardRevision[20] = "Hardware Revision X";   // will be corrected during in
 #include <U8g2lib.h>
 #include "TeensyTimerTool.h"      // hard- and software timers on teensy boards
 using namespace TeensyTimerTool;
-#include <EncoderTool.h>
-using namespace EncoderTool;
 
 #include "serialdebug.h"  // macros for serial debugging
 #include "ui.h"           // some UI methods of general use
 #include "audio.h"        // all things audio (derived from Adafruit_VS1053_FilePlayer)
 #include "buzzer.h"       // the buzzer and some helper methods
 #include "projector.h"    // management of the projector configuration & EEPROM storage
+#include "encoder.h"      // the rotary encoder, interrupt driven
+#include "profiler.h"     // CPU and bus time per subsystem (-D PROFILE)
 #include "pins.h"         // pin definitions
 #include "menus.h"        // menu definitions, positions of menu items
 
@@ -25,6 +25,10 @@ using namespace EncoderTool;
 #include "formatSD.h"     // include menu option for formatting SD cards
 #endif
 
+#if defined(PID_BENCHMARK)
+#include "pidbench.h"     // time the PID in float and fixed point at startup
+#endif
+
 // Use MTP disk?
 #if defined USB_MTPDISK || defined USB_MTPDISK_SERIAL
   #include <SD.h>
@@ -42,8 +46,7 @@ uint8_t u8x8_GetMenuEvent(u8x8_t);
 // Initialize Objects
 Audio musicPlayer;
 U8G2* u8g2;
-PolledEncoder enc;
-PeriodicTimer encTimer(TCK);
+RotaryEncoder enc;
 #if defined(__MKL26Z64__)
   OneShotTimer dimmingTimer(TCK);
 #else
@@ -93,10 +96,9 @@ void setup(void) {
 
   // initialize encoder
   PRINTLN("Initializing encoder ...");
-  enc.begin(ENC_A, ENC_B, ENC_BTN, CountMode::half, INPUT_PULLUP);        // Adjust CountMode if necessary
-  encTimer.begin([]() { enc.tick(); }, 5_kHz);                            // Poll encoder at 5kHz
-  enc.attachCallback([](int position, int delta) { dimDisplay(true); });  // Wake up display on encoder input
-  enc.attachButtonCallback([](int state) { dimDisplay(true); });          // Wake up display on button input
+  enc.begin(ENC_A, ENC_B, ENC_BTN);                                               // Swap ENC_A and ENC_B if necessary
+  enc.attachCallback([](int32_t value, int32_t delta) { dimDisplay(true); });     // Wake up display on encoder input
+  enc.attachButtonCallback([](bool state) { dimDisplay(true); });                 // Wake up display on button input
 
   // initialize VS1053B breakout
   while (!musicPlayer.SDinserted())
@@ -111,7 +113,7 @@ void setup(void) {
   // initialize MTP filesystem
   #if defined USB_MTBDISK || defined USB_MTPDISK_SERIAL
     MTP.addFilesystem(SD, "SD card");
-    mtpTimer.begin([]() { MTP.loop(); }, 50_Hz);
+    mtpTimer.begin([]() { PROFILE_SCOPE(PROFILE_MTP); MTP.loop(); }, 50_Hz);
   #endif
 
   // check for autostart file
@@ -119,6 +121,9 @@ void setup(void) {
     myState = MENU_SELECT_TRACK;
 
   projector.loadLast();
+  #if defined(PID_BENCHMARK)
+    pidBenchmark();
+  #endif
   PRINTLN("Startup complete.\n");
 }
 
@@ -162,6 +167,15 @@ void loop(void) {
     myState = MENU_MAIN;
     break;
 
+  case MENU_PROJECTOR_TUNE:
+    if (ui.userInterfaceMessage("Auto-Tune", "Play a film to tune", "the PID gains.", " Cancel \n OK ") == 2) {
+      while (!musicPlayer.selectTrack(true)) {}
+      detachInterrupt(STARTMARK);
+      digitalWriteFast(LED_BUILTIN, LOW);
+    }
+    myState = MENU_MAIN;
+    break;
+
   case MENU_SELECT_TRACK:
     while (!musicPlayer.selectTrack()) {}
     myState = MENU_MAIN;
@@ -187,6 +201,18 @@ void loop(void) {
     myState = MENU_MAIN;
     break;
 
+  case MENU_EXTRAS_BUFFERS:
+    musicPlayer.bufferHealth().show();
+    myState = MENU_MAIN;
+    break;
+
+#if defined(PROFILE)
+  case MENU_EXTRAS_PROFILE:
+    profiler.show();
+    myState = MENU_MAIN;
+    break;
+#endif
+
 #if defined(FORMAT_SD)
   case MENU_EXTRAS_FORMAT_SD:
     formatSD();
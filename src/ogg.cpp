@@ -0,0 +1,67 @@
+#include "ogg.h"
+
+StreamScanner::StreamScanner(const void *pattern, uint8_t length) {
+  _pattern = (const uint8_t*) pattern;
+  _length  = constrain(length, 1, SCAN_MAX_LENGTH);
+  memset(_skip, _length, sizeof(_skip));
+  for (uint8_t i = 0; i < _length - 1; i++)
+    _skip[_pattern[i]] = _length - 1 - i;
+}
+
+size_t StreamScanner::find(File *file, size_t from) const {
+  uint8_t buf[SCAN_SECTOR + SCAN_MAX_LENGTH];
+  size_t base = from;                             // file position of buf[0]
+  size_t n = 0;                                   // bytes in buf
+  size_t i = 0;                                   // window start in buf
+  if (!file->seek(from))
+    return UINT32_MAX;
+  for (;;) {
+    if (i + _length > n) {                        // window beyond buf: move it to the front ...
+      if (i < n) {
+        memmove(buf, &buf[i], n - i);
+        n -= i;
+      } else {
+        if (i > n)
+          file->seek(base + i);
+        n = 0;
+      }
+      base += i;
+      i = 0;
+      while (n < _length) {                       // ... and read up to the next sector boundary
+        int bytesRead = file->read(&buf[n], SCAN_SECTOR - (base + n) % SCAN_SECTOR);
+        if (bytesRead <= 0)
+          return UINT32_MAX;
+        n += bytesRead;
+      }
+    }
+    uint8_t last = buf[i + _length - 1];
+    if (last == _pattern[_length - 1] && !memcmp(&buf[i], _pattern, _length - 1))
+      return base + i;
+    i += _skip[last];
+  }
+}
+
+bool OggWalker::read(size_t pos) {
+  uint8_t lacing[255];
+  _pos = UINT32_MAX;
+  if (!_file->seek(pos) || _file->read(page.header, 27) != 27 ||
+      memcmp(page.magicStr, "OggS", 4) || page.version != 0)
+    return false;
+  if (_file->read(lacing, page.nSegments) != page.nSegments)
+    return false;
+  _pos  = pos;
+  _next = pos + 27 + page.nSegments;
+  for (uint8_t i = 0; i < page.nSegments; i++)
+    _next += lacing[i];
+  return true;
+}
+
+bool OggWalker::sync(size_t pos) {
+  const StreamScanner capture("OggS", 4);
+  while ((pos = capture.find(_file, pos)) != UINT32_MAX) {
+    if (read(pos) && granulePos() >= 0)
+      return true;
+    pos++;                                        // "OggS" in the payload, or no packet ends here
+  }
+  return false;
+}
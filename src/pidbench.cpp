@@ -0,0 +1,85 @@
+#if defined(PID_BENCHMARK)
+#include <QuickPID.h>
+#include "cycles.h"
+#include "fixedpid.h"
+#include "pidbench.h"
+#include "syncfilter.h"
+#include "ui.h"
+#include "serialdebug.h"
+
+// Times one PID tick - filter of the sync error and Compute() - with QuickPID
+// in float and with FixedPID, as selected by -D FIXED_PID. Both run the same
+// sequence of sync errors, the cost of generating it is subtracted. Timer
+// interrupts keep running, so expect a few cycles of noise.
+
+#define BENCH_TICKS 1000
+
+static uint32_t seed;
+
+static int32_t syncError(uint16_t tick) {
+  // a slow drift with some jitter [samples]
+  seed = seed * 1664525UL + 1013904223UL;
+  return tick * 4L - 2000 + (int32_t) (seed >> 24) - 128;
+}
+
+template <typename Step>
+static uint32_t measure(Step step) {
+  seed = 1;
+  uint32_t start = cycles();
+  for (uint16_t tick = 0; tick < BENCH_TICKS; tick++)
+    step(syncError(tick));
+  return cycles() - start;
+}
+
+static uint32_t perTick(uint32_t total, uint32_t overhead, const char *name) {
+  uint32_t c = (total > overhead) ? (total - overhead) / BENCH_TICKS : 0;
+#if defined(MYSERIAL)
+  uint32_t ns = c * 1000 / (F_CPU / 1000000);
+  PRINTF("  %-22s %5lu cycles, %3lu.%02lu us\n", name, c, ns / 1000, ns % 1000 / 10);
+#else
+  (void) name;
+#endif
+  return c;
+}
+
+void pidBenchmark(void) {
+  static volatile int32_t sink;
+  static float floatInput, floatOutput, floatSetpoint = 0;
+  static int32_t fixedInput, fixedOutput, fixedSetpoint = 0;
+  static QuickPID floatPID(&floatInput, &floatOutput, &floatSetpoint);
+  static FixedPID fixedPID(&fixedInput, &fixedOutput, &fixedSetpoint);
+  static Tracker tracker;
+  static FixedTracker fixedTracker;
+  static MovingAverage average;
+
+  // set up as in Audio::selectTrack()
+  floatPID.SetOutputLimits(-20000, 20000);
+  floatPID.SetProportionalMode(floatPID.pMode::pOnMeas);
+  floatPID.SetDerivativeMode(floatPID.dMode::dOnMeas);
+  floatPID.SetAntiWindupMode(floatPID.iAwMode::iAwClamp);
+  floatPID.SetTunings(8, 3, 1);
+  floatPID.SetMode(floatPID.Control::timer);
+  fixedPID.SetOutputLimits(-20000, 20000);
+  fixedPID.SetTunings(8, 3, 1);
+  fixedPID.SetMode(fixedPID.Control::timer);
+
+  PRINTLN("PID benchmark, per tick:");
+  cyclesBegin();
+  uint32_t overhead = measure([](int32_t e) { sink = e; });
+  uint32_t f = perTick(measure([](int32_t e) { floatInput = tracker.add(e); floatPID.Compute(); }),
+                       overhead, "float, tracker:");
+  perTick(measure([](int32_t e) { floatInput = average.add(e); floatPID.Compute(); }),
+          overhead, "float, moving average:");
+  average.clear();
+  uint32_t q = perTick(measure([](int32_t e) { fixedInput = fixedTracker.add(e); fixedPID.Compute(); }),
+                       overhead, "fixed, tracker:");
+  perTick(measure([](int32_t e) { fixedInput = average.add(e) * (1L << FIXED_Q); fixedPID.Compute(); }),
+          overhead, "fixed, moving average:");
+  PRINTLN("");
+
+  char line1[26], line2[26];                      // room for any uint32_t
+  snprintf(line1, sizeof(line1), "Float: %5lu cycles", f);
+  snprintf(line2, sizeof(line2), "Fixed: %5lu cycles", q);
+  ui.userInterfaceMessage("PID + Tracker", line1, line2, " Ok ");
+}
+#endif
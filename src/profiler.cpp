@@ -0,0 +1,161 @@
+#if defined(PROFILE)
+#include "profiler.h"
+#include "serialdebug.h"
+#include "ui.h"
+
+Profiler profiler;
+
+static const char *names[PROFILE_SECTIONS] = {
+  "impulse", "feeder", "tick", "PID", "display", "read-ahead", "encoder", "MTP",
+  "bus VS1053", "bus SD", "bus display"
+};
+
+// Sections end in interrupts as well as in the main loop, the bookkeeping
+// must not be interrupted. PRIMASK is restored rather than cleared, so this
+// also works where interrupts are disabled already.
+static inline uint32_t lock() {
+#if defined(SIMULATOR)
+  return 0;
+#else
+  uint32_t primask;
+  __asm__ volatile("mrs %0, primask\n\tcpsid i" : "=r" (primask) :: "memory");
+  return primask;
+#endif
+}
+
+static inline void unlock(uint32_t primask) {
+#if !defined(SIMULATOR)
+  __asm__ volatile("msr primask, %0" :: "r" (primask) : "memory");
+#else
+  (void) primask;
+#endif
+}
+
+void Profiler::start() {
+  cyclesBegin();
+  uint32_t primask = lock();
+  for (uint8_t i = 0; i < PROFILE_SECTIONS; i++)
+    stats[i] = Stats();
+  _startMicros = micros();
+  _wallMicros  = 0;
+  _running     = true;
+  unlock(primask);
+}
+
+void Profiler::stop() {
+  if (!_running)
+    return;
+  _running    = false;
+  _wallMicros = micros() - _startMicros;
+}
+
+void Profiler::enter(uint32_t &start, uint32_t &nested) {
+  uint32_t primask = lock();
+  nested = _nested;
+  start  = cycles();
+  unlock(primask);
+}
+
+void Profiler::leave(uint8_t section, uint32_t start, uint32_t nested) {
+  uint32_t primask = lock();
+  uint32_t total = cycles() - start;
+  uint32_t inner = _nested - nested;      // left by sections within this one
+  _nested = nested + total;               // for the section this one is in
+  if (_running)
+    add(section, total - inner);
+  unlock(primask);
+}
+
+void Profiler::busBegin(uint8_t section) {
+  _busStart[section - PROFILE_CPU_SECTIONS] = cycles();
+}
+
+void Profiler::busEnd(uint8_t section) {
+  uint32_t primask = lock();
+  if (_running)
+    add(section, cycles() - _busStart[section - PROFILE_CPU_SECTIONS]);
+  unlock(primask);
+}
+
+void Profiler::add(uint8_t section, uint32_t cycles) {
+  Stats &s = stats[section];
+  s.calls++;
+  s.total += cycles;
+  if (cycles < s.min) s.min = cycles;
+  if (cycles > s.max) s.max = cycles;
+}
+
+uint32_t Profiler::percent(uint8_t section) const {
+  uint64_t wall = (uint64_t) (_running ? micros() - _startMicros : _wallMicros) * (F_CPU / 1000000);
+  return (wall) ? stats[section].total * 10000 / wall : 0;
+}
+
+static uint32_t tenthsMicros(uint64_t cycles) {
+  return cycles * 10 / (F_CPU / 1000000);
+}
+
+void Profiler::print() const {
+#if defined(MYSERIAL)
+  uint32_t wall = _running ? micros() - _startMicros : _wallMicros;
+  PRINTF("Profile over %lu ms at %lu MHz:\n", wall / 1000, (uint32_t) (F_CPU / 1000000));
+  PRINTLN("  section          calls  min [us]  mean [us]  max [us]  wall [%]");
+  uint32_t busy = 0;
+  for (uint8_t i = 0; i < PROFILE_SECTIONS; i++) {
+    const Stats &s = stats[i];
+    uint32_t p = percent(i);
+    if (i < PROFILE_CPU_SECTIONS)
+      busy += p;
+    if (!s.calls)
+      continue;
+    uint32_t min  = tenthsMicros(s.min);
+    uint32_t mean = tenthsMicros(s.total / s.calls);
+    uint32_t max  = tenthsMicros(s.max);
+    PRINTF("  %-12s %9lu %7lu.%lu %8lu.%lu %7lu.%lu %6lu.%02lu\n", names[i], s.calls,
+      min / 10, min % 10, mean / 10, mean % 10, max / 10, max % 10, p / 100, p % 100);
+  }
+  PRINTF("  CPU busy %lu.%02lu %%\n", busy / 100, busy % 100);
+#endif
+}
+
+void Profiler::drawLine(uint8_t y, uint8_t section) const {
+  // share of wall time and the longest call
+  char buffer[24];
+  uint32_t p   = percent(section);
+  uint32_t max = tenthsMicros(stats[section].calls ? stats[section].max : 0) / 10;
+  u8g2->drawStr(0, y, names[section]);
+  snprintf(buffer, sizeof(buffer), "%lu.%02lu%%", (unsigned long) p / 100, (unsigned long) p % 100);
+  u8g2->drawStr(56, y, buffer);
+  snprintf(buffer, sizeof(buffer), "%lu", (unsigned long) max);
+  u8g2->drawStr(128 - u8g2->getStrWidth(buffer), y, buffer);
+}
+
+void Profiler::show() const {
+  // the sections scroll with the encoder
+  char buffer[24];
+  uint32_t busy = 0;
+  for (uint8_t i = 0; i < PROFILE_CPU_SECTIONS; i++)
+    busy += percent(i);
+  enc.setLimits(0, PROFILE_SECTIONS - PROFILE_SHOW_LINES);
+  enc.setValue(0);
+  bool first = true;
+  u8g2->setFont(FONT08);
+  while (enc.getButton()) {
+    yield();
+    if (!enc.valueChanged() && !first)
+      continue;
+    first = false;
+    u8g2->clearBuffer();
+    snprintf(buffer, sizeof(buffer), "CPU busy: %lu.%02lu%%", (unsigned long) busy / 100, (unsigned long) busy % 100);
+    ui.drawCenteredStr(8, buffer);
+    u8g2->drawStr(56, 18, "wall");
+    u8g2->drawStr(96, 18, "max us");
+    for (uint8_t i = 0; i < PROFILE_SHOW_LINES; i++)
+      drawLine(28 + i * 9, enc.getValue() + i);
+    u8g2->sendBuffer();
+  }
+  u8g2->setFont(FONT10);
+  enc.setLimits(-999,999);
+  enc.setValue(0);
+  ui.waitForBttnRelease();
+}
+#endif
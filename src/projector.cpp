@@ -1,5 +1,6 @@
 #include <Arduino.h>
 #include <EEPROM.h>
+#include <stddef.h>
 #include "projector.h"
 #include "ui.h"
 #include "serialdebug.h"
@@ -43,18 +44,19 @@ bool Projector::load(uint8_t idx) {
   PRINT("  Start Mark Offset: ");
   PRINT(config_.startmarkOffset);
   PRINTLN(" frames");
-  PRINT("  Proportional:      ");
-  PRINTLN(config_.p);
-  PRINT("  Integral:          ");
-  PRINTLN(config_.i);
-  PRINT("  Derivative:        ");
-  PRINTLN(config_.d);
+  PRINTF("  Proportional:      %u.%02u\n", config_.p, config_.pFrac);
+  PRINTF("  Integral:          %u.%02u\n", config_.i, config_.iFrac);
+  PRINTF("  Derivative:        %u.%02u\n", config_.d, config_.dFrac);
+  PRINT("  Filter:            ");
+  PRINTLN((config_.filter == FILTER_TRACKER) ? "Tracker" : "Moving Average");
   PRINTLN("");
 
   return true;
 }
 
 void Projector::loadLast(void) {
+  if (EEPROM.read(EEPROM_IDX_VERSION) != EEPROM_VERSION)
+    e2migrate();
   if (load(lastUsed()))
     return;
   e2delete(); // EEPROM invalid - reinitialize
@@ -119,10 +121,14 @@ bool Projector::edit(uint8_t idx) {
   ui.reverseEncoder(true);
   u8g2->userInterfaceInputValue("# Shutter Blades:", "", &aProjector.shutterBladeCount, 1, 4, 1, "");
   u8g2->userInterfaceInputValue("Start Mark Offset:", "", &aProjector.startmarkOffset, 1, 255, 3, " Frames");
-  u8g2->userInterfaceInputValue("Proportional:", "", &aProjector.p, 0, 99, 2, "");
-  u8g2->userInterfaceInputValue("Integral:", "", &aProjector.i, 0, 99, 2, "");
-  u8g2->userInterfaceInputValue("Derivative:", "", &aProjector.d, 0, 99, 2, "");
+  editGain("Proportional:", &aProjector.p, &aProjector.pFrac);
+  editGain("Integral:", &aProjector.i, &aProjector.iFrac);
+  editGain("Derivative:", &aProjector.d, &aProjector.dFrac);
   ui.reverseEncoder(false);
+  uint8_t filter = u8g2->userInterfaceSelectionList("Sync Error Filter", aProjector.filter + 1,
+                                                    "Moving Average\nTracker");
+  if (filter > 0)
+    aProjector.filter = filter - 1;
 
   if (idx == 0) {      // we have a NEW projector here
     idx = count() + 1; // set new idx
@@ -132,6 +138,28 @@ bool Projector::edit(uint8_t idx) {
   return load(idx);        // use this projector
 }
 
+void Projector::editGain(const char *title, uint8_t *whole, uint8_t *hundredths) {
+  // whole part first, then the hundredths behind it
+  char pre[5];             // "255." at most
+  u8g2->userInterfaceInputValue(title, "", whole, 0, 99, 2, ".");
+  snprintf(pre, sizeof(pre), "%u.", *whole);
+  u8g2->userInterfaceInputValue(title, pre, hundredths, 0, 99, 2, "");
+}
+
+void Projector::setGains(uint16_t p, uint16_t i, uint16_t d) {
+  uint8_t idx = lastUsed();
+  if (idx > count() || idx == 0)
+    return;
+  config_.p     = p / 100;
+  config_.pFrac = p % 100;
+  config_.i     = i / 100;
+  config_.iFrac = i % 100;
+  config_.d     = d / 100;
+  config_.dFrac = d % 100;
+  e2save(idx, config_);
+  load(idx);               // print details
+}
+
 uint8_t Projector::select(const char *prompt) {
   uint8_t c = count();
   char menu[MAX_PROJECTOR_NAME_LENGTH * MAX_PROJECTOR_COUNT + MAX_PROJECTOR_COUNT] = {0};
@@ -145,14 +173,79 @@ uint8_t Projector::select(const char *prompt) {
   return u8g2->userInterfaceSelectionList(prompt, lastUsed(), menu);
 }
 
+// A record takes 17 bytes, so the Teensy LC still holds 7 projectors:
+//   0     shutter blades (bits 0-2), filter (bit 7)
+//   1     start mark offset
+//   2-7   P, I and D in hundredths, 16 bits each
+//   8-16  name, 6 bits per character
+static_assert(MAX_PROJECTOR_COUNT >= EEPROM_V0_MAX_PROJECTORS, "legacy projectors must fit");
+
+// Characters offered by UI::editCharArray(), coded from 1 - 0 ends the name
+static const char nameChars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789 ";
+static_assert(sizeof(nameChars) == 64, "names are coded in 6 bits");
+
 EEPROMstruct Projector::e2load(uint8_t idx) {
   EEPROMstruct aProjector;
-  EEPROM.get((idx - 1) * sizeof(EEPROMstruct) + EEPROM_HEADER_BYTES, aProjector);
+  uint8_t rec[EEPROM_BYTES_PER_PROJECTOR];
+  EEPROM.get((idx - 1) * EEPROM_BYTES_PER_PROJECTOR + EEPROM_HEADER_BYTES, rec);
+
+  aProjector.shutterBladeCount = rec[0] & 0x07;
+  aProjector.filter = rec[0] >> 7;
+  aProjector.startmarkOffset = rec[1];
+  uint8_t *whole[] = {&aProjector.p, &aProjector.i, &aProjector.d};
+  uint8_t *frac[]  = {&aProjector.pFrac, &aProjector.iFrac, &aProjector.dFrac};
+  for (uint8_t k = 0; k < 3; k++) {
+    uint16_t gain = rec[2 + 2*k] | rec[3 + 2*k] << 8;
+    *whole[k] = gain / 100;
+    *frac[k]  = gain % 100;
+  }
+
+  uint16_t bits = 0;
+  uint8_t n = 0, *in = &rec[8];
+  for (uint8_t k = 0; k < MAX_PROJECTOR_NAME_LENGTH; k++) {
+    if (n < 6) {
+      bits = bits << 8 | *in++;
+      n += 8;
+    }
+    n -= 6;
+    uint8_t code = (bits >> n) & 0x3F;
+    if (code == 0)
+      break;
+    aProjector.name[k] = nameChars[code - 1];
+  }
   return aProjector;
 }
 
 void Projector::e2save(uint8_t idx, EEPROMstruct &data) {
-  EEPROM.put((idx - 1) * sizeof(EEPROMstruct) + EEPROM_HEADER_BYTES, data);
+  uint8_t rec[EEPROM_BYTES_PER_PROJECTOR];
+  rec[0] = (data.shutterBladeCount & 0x07) | (data.filter ? 0x80 : 0);
+  rec[1] = data.startmarkOffset;
+  uint16_t gains[] = {(uint16_t) (data.p * 100 + data.pFrac),
+                      (uint16_t) (data.i * 100 + data.iFrac),
+                      (uint16_t) (data.d * 100 + data.dFrac)};
+  for (uint8_t k = 0; k < 3; k++) {
+    rec[2 + 2*k] = gains[k];
+    rec[3 + 2*k] = gains[k] >> 8;
+  }
+
+  uint16_t bits = 0;
+  uint8_t n = 0, *out = &rec[8];
+  bool end = false;
+  for (uint8_t k = 0; k < MAX_PROJECTOR_NAME_LENGTH; k++) {
+    uint8_t code = 0;
+    if (!end && data.name[k]) {
+      const char *c = strchr(nameChars, data.name[k]);
+      code = c ? c - nameChars + 1 : sizeof(nameChars) - 1;  // anything else becomes a space
+    } else
+      end = true;
+    bits = bits << 6 | code;
+    n += 6;
+    if (n >= 8) {
+      n -= 8;
+      *out++ = bits >> n;
+    }
+  }
+  EEPROM.put((idx - 1) * EEPROM_BYTES_PER_PROJECTOR + EEPROM_HEADER_BYTES, rec);
 }
 
 void Projector::e2dump(void) {
@@ -175,10 +268,71 @@ void Projector::e2dump(void) {
 #endif
 }
 
+bool Projector::e2valid(uint8_t header, uint8_t bytes, uint8_t c) {
+  // 1 to 4 shutter blades and a name of printable characters, in every record
+  if (c == 0)
+    return false;
+  for (uint8_t idx = 0; idx < c; idx++) {
+    uint16_t address = idx * bytes + header;
+    uint8_t blades = EEPROM.read(address);
+    if (blades < 1 || blades > 4)
+      return false;
+    address += offsetof(EEPROMstruct, name);
+    uint8_t len = 0;
+    for (char ch; len <= MAX_PROJECTOR_NAME_LENGTH && (ch = EEPROM.read(address + len)); len++)
+      if (ch < ' ' || ch > '~')
+        return false;
+    if (len > MAX_PROJECTOR_NAME_LENGTH)  // not terminated
+      return false;
+  }
+  return true;
+}
+
 void Projector::e2delete(void) {
   PRINTLN("Deleting contents of EEPROM ...");
   for (int i = 0; i < EEPROM.length(); i++)
     EEPROM.update(i, 0);
+  EEPROM.update(EEPROM_IDX_VERSION, EEPROM_VERSION);
   e2dump();
   create();
 }
+
+void Projector::e2migrate(void) {
+  // The legacy layout has no version byte - instead, EEPROM_IDX_VERSION holds
+  // the shutter blade count of the first projector (1 to 4), which is why
+  // layouts are numbered from 5. As that byte alone could be anything, the
+  // records are checked as well. Anything else is treated as uninitialized.
+  // Every older layout has larger records, so they all fit.
+  uint8_t c = count();
+  uint8_t version = EEPROM.read(EEPROM_IDX_VERSION);
+  uint8_t header = EEPROM_HEADER_BYTES, bytes;
+  auto fits = [&](uint8_t b) {
+    return c <= (EEPROM_SIZE - EEPROM_HEADER_BYTES) / b && e2valid(EEPROM_HEADER_BYTES, b, c);
+  };
+  if (c <= EEPROM_V0_MAX_PROJECTORS
+      && e2valid(EEPROM_V0_HEADER_BYTES, EEPROM_V0_BYTES_PER_PROJECTOR, c)) {
+    header = EEPROM_V0_HEADER_BYTES;
+    bytes  = EEPROM_V0_BYTES_PER_PROJECTOR;
+  } else if (version == 5 && fits(EEPROM_V5_BYTES_PER_PROJECTOR)) {
+    bytes  = EEPROM_V5_BYTES_PER_PROJECTOR;
+  } else if (version == 6 && fits(EEPROM_V6_BYTES_PER_PROJECTOR)) {
+    bytes  = EEPROM_V6_BYTES_PER_PROJECTOR;
+  } else {
+    count(0);
+    return;
+  }
+  PRINTLN("Migrating contents of EEPROM ...");
+  for (uint8_t idx = 1; idx <= c; idx++) { // records only move down in EEPROM
+    EEPROMstruct aProjector;   // new fields keep their defaults
+    for (uint8_t i = 0; i < bytes; i++)
+      ((uint8_t*) &aProjector)[i] = EEPROM.read((idx - 1) * bytes + header + i);
+    if (header == EEPROM_V0_HEADER_BYTES)  // keep the filter these were set up with
+      aProjector.filter = FILTER_AVERAGE;
+    e2save(idx, aProjector);
+  }
+  count(c);
+  if (lastUsed() > c)
+    lastUsed(1);
+  EEPROM.update(EEPROM_IDX_VERSION, EEPROM_VERSION);
+  e2dump();
+}
@@ -0,0 +1,52 @@
+#include <atomic>
+#include "readahead.h"
+
+void ReadAhead::clear(uint32_t filePos) {
+  _head  = filePos % READ_AHEAD_SECTOR;
+  _tail  = _head;
+  _eof   = false;
+  _depth = READ_AHEAD_BYTES;
+}
+
+void ReadAhead::setDepth(uint16_t bytes) {
+  bytes  = (bytes + READ_AHEAD_SECTOR - 1) / READ_AHEAD_SECTOR * READ_AHEAD_SECTOR;
+  _depth = constrain(bytes, 2 * READ_AHEAD_SECTOR, READ_AHEAD_BYTES);
+}
+
+bool ReadAhead::fill(File &file, uint32_t end) {
+  uint32_t head = _head;
+  uint16_t n = READ_AHEAD_SECTOR - head % READ_AHEAD_SECTOR;  // up to next sector boundary
+  if (_eof || (head - _tail) + n > _depth)
+    return false;
+  if (end - file.position() < n)                              // ... or up to end
+    n = end - file.position();
+  if (n == 0)
+    return false;
+
+  std::atomic_signal_fence(std::memory_order_acquire);
+  int bytesRead = file.read(&_buffer[head % READ_AHEAD_BYTES], n);
+  if (bytesRead < n)
+    _eof = true;
+  if (bytesRead <= 0)
+    return false;
+  std::atomic_signal_fence(std::memory_order_release);
+  _head = head + bytesRead;
+  return true;
+}
+
+uint16_t ReadAhead::peek(uint8_t *&data, uint16_t max) {
+  uint32_t tail = _tail;
+  uint32_t n = _head - tail;
+  if (n > READ_AHEAD_BYTES - tail % READ_AHEAD_BYTES)   // don't wrap around
+    n = READ_AHEAD_BYTES - tail % READ_AHEAD_BYTES;
+  if (n > max)
+    n = max;
+  std::atomic_signal_fence(std::memory_order_acquire);
+  data = &_buffer[tail % READ_AHEAD_BYTES];
+  return n;
+}
+
+void ReadAhead::consume(uint16_t n) {
+  std::atomic_signal_fence(std::memory_order_release);
+  _tail = _tail + n;
+}
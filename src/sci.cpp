@@ -0,0 +1,110 @@
+#include <SPI.h>
+#include <Adafruit_VS1053.h>
+#include "sci.h"
+#include "sdi.h"
+#include "profiler.h"
+
+#define SCI_OP_WRITE      0x02
+#define SCI_OP_READ       0x03
+
+// SCI reads are specified up to CLKI/7, writes up to CLKI/4. The Adafruit
+// library sets SC_MULT to 3.0x (CLKI = 36.864 MHz) in reset() but runs SCI at
+// 250 kHz to be on the safe side before that.
+#define SCI_CLOCK         4000000
+#define SCI_WORD_GAP      1       // [us] between words of a multiple write
+
+static const SPISettings sciSettings(SCI_CLOCK, MSBFIRST, SPI_MODE0);
+
+void SciBus::begin() {
+  pinMode(_cs, OUTPUT);
+  digitalWriteFast(_cs, HIGH);
+  bytes = 0;
+  busMicros = 0;
+}
+
+void SciBus::beginBurst() {
+  // The PID tick interrupt has bursts of its own (see Audio::sampleTick()).
+  // Until the transaction masks it, it may run one in between, so the depth
+  // is only counted once the bus is ours - from then on, it can't interfere.
+  if (_depth == 0) {
+#if defined(SDI_DMA)
+    if (_sdi)
+      _sdi->hold();                       // before masking the DMA interrupt
+#endif
+    SPI.beginTransaction(sciSettings);    // also masks the DREQ and tick interrupts
+    _burstStart = micros();
+    PROFILE_BUS_BEGIN(PROFILE_BUS_VS1053);
+  }
+  _depth++;
+}
+
+void SciBus::endBurst() {
+  if (--_depth > 0)                       // still within the transaction
+    return;
+  busMicros += micros() - _burstStart;
+  PROFILE_BUS_END(PROFILE_BUS_VS1053);
+  SPI.endTransaction();
+#if defined(SDI_DMA)
+  if (_sdi)
+    _sdi->release();
+#endif
+}
+
+void SciBus::select() {
+  digitalWriteFast(_cs, LOW);
+}
+
+void SciBus::deselect() {
+  digitalWriteFast(_cs, HIGH);
+}
+
+uint16_t SciBus::read(uint8_t addr) {
+  beginBurst();
+  select();
+  SPI.transfer(SCI_OP_READ);
+  SPI.transfer(addr);
+  uint16_t data = SPI.transfer(0xFF) << 8;
+  data |= SPI.transfer(0xFF);
+  deselect();
+  bytes += 4;
+  endBurst();
+  return data;
+}
+
+void SciBus::write(uint8_t addr, uint16_t data) {
+  write(addr, &data, 1);
+}
+
+void SciBus::write(uint8_t addr, const uint16_t *data, uint8_t n) {
+  // after each word the VS1053B needs a few clock cycles to process it (see
+  // section 7.4.4 of the VS1053B datasheet). DREQ signals that, too, but
+  // can't be told apart from a full stream buffer during playback.
+  beginBurst();
+  select();
+  SPI.transfer(SCI_OP_WRITE);
+  SPI.transfer(addr);
+  for (uint8_t i = 0; i < n; i++) {
+    if (i > 0)
+      delayMicroseconds(SCI_WORD_GAP);
+    SPI.transfer(data[i] >> 8);
+    SPI.transfer(data[i] & 0xFF);
+  }
+  deselect();
+  bytes += 2 + 2 * n;
+  endBurst();
+}
+
+void SciBus::readWRAM(uint16_t addr, uint16_t *data, uint8_t n) {
+  beginBurst();
+  write(VS1053_REG_WRAMADDR, addr);       // increments with every access of WRAM
+  for (uint8_t i = 0; i < n; i++)
+    data[i] = read(VS1053_REG_WRAM);
+  endBurst();
+}
+
+void SciBus::writeWRAM(uint16_t addr, const uint16_t *data, uint8_t n) {
+  beginBurst();
+  write(VS1053_REG_WRAMADDR, addr);
+  write(VS1053_REG_WRAM, data, n);
+  endBurst();
+}
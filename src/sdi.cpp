@@ -0,0 +1,92 @@
+#include <SPI.h>
+#include "sdi.h"
+#include "profiler.h"
+
+#if defined(SDI_DMA)
+
+#if defined(__MKL26Z64__)                         // Teensy LC  [MKL26Z64]
+  #define SDI_DATA_REG     SPI0_DL
+  #define SDI_DMA_ON()     SPI0_C2 |= SPI_C2_TXDMAE
+  #define SDI_DMA_OFF()    SPI0_C2 &= ~SPI_C2_TXDMAE
+  #define SDI_FLUSH()      do { while (!(SPI0_S & SPI_S_SPTEF)) {}  /* last byte in shifter */ \
+                                delayMicroseconds(1);                                          \
+                                (void) SPI0_S; (void) SPI0_DL; } while (0)  // clear SPRF
+#elif defined(__MK20DX256__)                      // Teensy 3.2 [MK20DX256]
+  #define SDI_DATA_REG     (*(volatile uint8_t*) &SPI0_PUSHR)
+  #define SDI_DMA_ON()     SPI0_RSER = SPI_RSER_TFFF_RE | SPI_RSER_TFFF_DIRS
+  #define SDI_DMA_OFF()    SPI0_RSER = 0
+  #define SDI_FLUSH()      do { while (SPI0_SR & (15 << 12)) {}     /* TX FIFO empty */       \
+                                while (!(SPI0_SR & SPI_SR_TCF)) {}                             \
+                                SPI0_MCR |= SPI_MCR_CLR_RXF;                                   \
+                                SPI0_SR = SPI_SR_TCF | SPI_SR_RFOF | SPI_SR_RFDF; } while (0)
+#elif defined(SIMULATOR)                          // host, see sim/include/DMAChannel.h
+  #define SDI_DATA_REG     SPI0_DL
+  #define SDI_DMA_ON()
+  #define SDI_DMA_OFF()
+  #define SDI_FLUSH()
+#else
+  #error "SDI_DMA: not supported on this board"
+#endif
+
+// VS1053_DATA_SPI_SETTING of the Adafruit library
+static const SPISettings sdiSettings(8000000, MSBFIRST, SPI_MODE0);
+static SdiBus *instance = nullptr;
+
+void SdiBus::begin(void (*sent)(uint8_t), void (*ready)()) {
+  instance = this;
+  _sent  = sent;
+  _ready = ready;
+  pinMode(_dcs, OUTPUT);
+  digitalWriteFast(_dcs, HIGH);
+  _dma.destination(SDI_DATA_REG);
+  _dma.triggerAtHardwareEvent(DMAMUX_SOURCE_SPI0_TX);
+  _dma.disableOnCompletion();
+  _dma.interruptAtCompletion();
+  _dma.attachInterrupt(isr);
+  SPI.usingInterrupt((IRQ_NUMBER_t) (IRQ_DMA_CH0 + _dma.channel));
+}
+
+bool SdiBus::send(const uint8_t *data, uint8_t n) {
+  if (_busy || _held || n == 0)
+    return false;
+  _busy = true;
+  _n = n;
+  SPI.beginTransaction(sdiSettings);              // apply clock & mode, the
+  SPI.endTransaction();                           // DMA interrupt must not be masked
+  PROFILE_BUS_BEGIN(PROFILE_BUS_VS1053);
+  digitalWriteFast(_dcs, LOW);
+  _dma.sourceBuffer(data, n);
+  SDI_DMA_ON();
+  _dma.enable();
+  chunks++;
+  return true;
+}
+
+void SdiBus::finish() {
+  SDI_FLUSH();
+  SDI_DMA_OFF();
+  digitalWriteFast(_dcs, HIGH);
+  PROFILE_BUS_END(PROFILE_BUS_VS1053);
+  _busy = false;
+  if (_sent)
+    _sent(_n);
+}
+
+void SdiBus::isr() {
+  instance->_dma.clearInterrupt();
+  instance->finish();
+  if (instance->_ready)
+    instance->_ready();
+}
+
+void SdiBus::hold() {
+  _held++;                                        // nested, e.g. by the tick interrupt
+  while (_busy)                                   // completed by isr()
+    delayMicroseconds(1);
+}
+
+void SdiBus::release() {
+  _held--;
+}
+
+#endif
@@ -0,0 +1,80 @@
+#include "sessionlog.h"
+
+bool SessionLog::begin(const char *name, logHeader header) {
+  _used = 0;
+  _fill = 0;
+  _full[0] = _full[1] = false;
+  _sectors = _records = _dropped = 0;
+  _file = SD.sdfs.open(name, O_WRONLY | O_CREAT | O_TRUNC);
+  if (!_file)
+    return false;
+  if (!_file.preAllocate((uint64_t) SESSION_LOG_MB << 20)) {
+    _file.close();                                  // card full or fragmented
+    SD.sdfs.remove(name);
+    return false;
+  }
+  header.recordSize = sizeof(logRecord);
+  memset(_buffer[0], 0, LOG_SECTOR);
+  memcpy(_buffer[0], &header, sizeof(header));
+  if (!writeSector(_buffer[0]) || !_file.sync()) {
+    _file.close();
+    return false;
+  }
+  return true;
+}
+
+void SessionLog::add(const logRecord &record) {
+  if (!_file)
+    return;
+  if (_full[_fill]) {
+    _dropped++;
+    return;
+  }
+  memcpy(&_buffer[_fill][_used], &record, sizeof(record));
+  _used += sizeof(record);
+  if (_used == LOG_SECTOR) {
+    _full[_fill] = true;
+    _fill ^= 1;
+    _used = 0;
+  }
+}
+
+void SessionLog::flush() {
+  // the older of the full halves: both are full only if records are dropped
+  uint8_t i = (_full[_fill]) ? _fill : _fill ^ 1;
+  if (!_full[i])
+    return;
+  if (_sectors < ((uint32_t) SESSION_LOG_MB << 20) / LOG_SECTOR - 1 && writeSector(_buffer[i])) {
+    _records += LOG_SECTOR / sizeof(logRecord);
+    if (++_sectors % LOG_SYNC_SECTORS == 0)
+      _file.sync();                                 // survives a power cut up to here
+  } else
+    _dropped += LOG_SECTOR / sizeof(logRecord);
+  _full[i] = false;
+}
+
+void SessionLog::end(logHeader header) {
+  if (!_file)
+    return;
+  while (pending())
+    flush();
+  if (_used) {                                      // partial sector, padded with zeros
+    memset(&_buffer[_fill][_used], 0, LOG_SECTOR - _used);
+    if (writeSector(_buffer[_fill]))
+      _records += _used / sizeof(logRecord);
+  }
+  _file.truncate();                                 // release what wasn't used
+  header.recordSize = sizeof(logRecord);
+  header.records = _records;
+  header.dropped = _dropped;
+  memset(_buffer[0], 0, LOG_SECTOR);
+  memcpy(_buffer[0], &header, sizeof(header));
+  _file.seek(0);
+  writeSector(_buffer[0]);
+  _file.close();
+}
+
+bool SessionLog::writeSector(const uint8_t *data) {
+  // sector aligned, whole sectors: goes straight to the card, bypassing the cache
+  return _file.write(data, LOG_SECTOR) == LOG_SECTOR;
+}
@@ -0,0 +1,33 @@
+#include "syncfilter.h"
+
+int32_t MovingAverage::add(int32_t error) {
+  _idx = (_idx + 1) % PID_FILTER_N;
+  _total -= _readings[_idx];                  // subtract oldest reading from running total
+  _readings[_idx] = error;
+  _total += error;
+  return _total / PID_FILTER_N;
+}
+
+void MovingAverage::clear() {
+  memset(_readings, 0, sizeof(_readings));
+  _total = 0;
+}
+
+float Tracker::add(int32_t error) {
+  float predicted = _offset + _rate;
+  float residual  = error - predicted;
+  _offset         = predicted + TRACKER_ALPHA * residual;
+  _rate          += TRACKER_BETA * residual;
+  return _offset;
+}
+
+int32_t FixedTracker::add(int32_t error) {
+  // Q8 holds sync errors of up to 2^23 samples - a few minutes. Products are
+  // Q24 and rounded back to Q8.
+  const int32_t limit = (1L << (31 - FIXED_Q)) - 1;
+  int32_t predicted = _offset + _rate;
+  int32_t residual  = constrain(error, -limit, limit) * (1L << FIXED_Q) - predicted;
+  _offset           = predicted + (int32_t) (((int64_t) alpha * residual + 32768) >> 16);
+  _rate            += (int32_t) (((int64_t) beta * residual + 32768) >> 16);
+  return _offset;
+}
@@ -0,0 +1,60 @@
+#include "telemetry.h"
+
+void Telemetry::begin() {
+#if !defined(MYSERIAL)
+  TELEMETRY_PORT.begin(TELEMETRY_BAUD);           // otherwise done in setup()
+#endif
+}
+
+bool Telemetry::send(uint8_t type, const void *record, uint8_t length) {
+  if (length > TELEMETRY_MAX_PAYLOAD)
+    return false;
+  uint8_t raw[TELEMETRY_MAX_PAYLOAD + 4];
+  raw[0] = type;
+  raw[1] = _seq++;                                // counts dropped frames, too
+  memcpy(&raw[2], record, length);
+  uint16_t crc = crc16(raw, length + 2);
+  raw[length + 2] = crc;
+  raw[length + 3] = crc >> 8;
+
+  // COBS: each zero is replaced by the distance to the next one, the first
+  // byte is the distance to the first. Frames are shorter than 254 bytes.
+  uint8_t frame[TELEMETRY_MAX_PAYLOAD + 6];
+  uint8_t code = 0, n = 1;
+  for (uint8_t i = 0; i < length + 4; i++) {
+    if (raw[i]) {
+      frame[n++] = raw[i];
+      continue;
+    }
+    frame[code] = n - code;
+    code = n++;
+  }
+  frame[code] = n - code;
+  frame[n++] = 0;                                 // delimiter
+
+  if (TELEMETRY_BUFFER - _tx.available() < n) {
+    _dropped++;
+    return false;
+  }
+  for (uint8_t i = 0; i < n; i++)
+    _tx.push(frame[i]);
+  return true;
+}
+
+void Telemetry::pump() {
+  int room = TELEMETRY_PORT.availableForWrite();
+  uint8_t b;
+  while (room-- > 0 && _tx.pop(b))
+    TELEMETRY_PORT.write(b);
+}
+
+uint16_t Telemetry::crc16(const uint8_t *data, uint8_t length) {
+  // CRC-16/CCITT-FALSE: polynomial 0x1021, initial value 0xFFFF
+  uint16_t crc = 0xFFFF;
+  while (length--) {
+    crc ^= (uint16_t) *data++ << 8;
+    for (uint8_t bit = 0; bit < 8; bit++)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
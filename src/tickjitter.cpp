@@ -0,0 +1,35 @@
+#include "tickjitter.h"
+#include "serialdebug.h"
+
+void TickJitter::clear(uint32_t nominal) {
+  _nominal    = nominal;
+  ticks       = 0;
+  shortest    = UINT32_MAX;
+  longest     = 0;
+  maxDelay    = 0;
+  _sumSquares = 0;
+  _sumDelay   = 0;
+}
+
+void TickJitter::add(uint32_t period, uint32_t delay) {
+  int32_t deviation = period - _nominal;
+  ticks++;
+  if (period < shortest) shortest = period;
+  if (period > longest)  longest  = period;
+  if (delay > maxDelay)  maxDelay = delay;
+  _sumSquares += (int64_t) deviation * deviation;
+  _sumDelay   += delay;
+}
+
+float TickJitter::rms() const {
+  return (ticks) ? sqrtf((float) _sumSquares / ticks) : 0;
+}
+
+void TickJitter::print() const {
+  if (!ticks)
+    return;
+  PRINTF("PID ticks: %lu, period %lu to %lu us (RMS deviation ", ticks, shortest, longest);
+  PRINT(rms(), 1);
+  PRINTF(" us), computed %lu us after the sample on average, %lu us at most\n",
+    (uint32_t) (_sumDelay / ticks), maxDelay);
+}
@@ -0,0 +1,128 @@
+#include <SD.h>
+#include "tracks.h"
+
+bool TrackDirectory::scan() {
+  _n = 0;
+  _complete = true;
+  File root = SD.open("/");
+  for (File file = root.openNextFile(); file; file = root.openNextFile()) {
+    uint32_t entry;
+    if (!file.isDirectory() && parse(file.name(), &entry)) {
+      uint16_t i = lowerBound(entry);           // insert, keeping the table sorted
+      if (_n == TRACKS_MAX)
+        _complete = false;
+      else if (i == _n || _entries[i] != entry) {
+        memmove(&_entries[i + 1], &_entries[i], (_n - i) * sizeof(_entries[0]));
+        _entries[i] = entry;
+        _n++;
+      }
+    }
+    file.close();
+  }
+  root.close();
+  _valid = true;
+  return _complete;
+}
+
+bool TrackDirectory::find(uint16_t track, char *fps, bool *loop) const {
+  uint16_t i = lowerBound((uint32_t) track << 20);
+  if (i == _n || _entries[i] >> 20 != track)
+    return false;
+  // "23.976" from 23976 and 3 decimals
+  uint16_t milli    = _entries[i] >> 2 & 0x7FFF;
+  uint8_t  decimals = _entries[i] & 3;
+  char digits[5];
+  for (int8_t d = 4; d >= 0; d--, milli /= 10)
+    digits[d] = '0' + milli % 10;
+  memcpy(fps, digits, 2);
+  fps[2] = '.';
+  memcpy(&fps[3], &digits[2], decimals);
+  fps[(decimals) ? 3 + decimals : 2] = 0;
+  *loop = _entries[i] & (1UL << 19);
+  return true;
+}
+
+bool TrackDirectory::rate(const char *fps, frameRate *rate) {
+  // Rates like 16 2/3 or 23.976 can only be approximated in a name. The name
+  // is taken for the simplest fraction with a denominator of 1, 3 or 1001
+  // (NTSC: multiples of 1000/1001) that it is a rounding of, or as it stands.
+  uint16_t milli;
+  uint8_t  decimals;
+  if (!parseFps(fps, strlen(fps), &milli, &decimals))
+    return false;
+  uint16_t unit = (decimals == 3) ? 1 : (decimals == 2) ? 10 : (decimals == 1) ? 100 : 1000;
+  for (uint16_t den : {1, 3, 1001}) {
+    uint32_t step  = (den == 1001) ? 1000 : 1;
+    uint32_t num   = ((uint32_t) milli * den / step + 500) / 1000 * step;
+    uint32_t exact = (uint32_t) milli * den;
+    uint32_t error = (num * 1000 > exact) ? num * 1000 - exact : exact - num * 1000;
+    if (2 * error < (uint32_t) unit * den) {
+      rate->num = num;
+      rate->den = den;
+      return true;
+    }
+  }
+  uint16_t a = milli, b = 1000;                   // reduce milli / 1000
+  while (b) {
+    uint16_t t = a % b;
+    a = b;
+    b = t;
+  }
+  rate->num = milli / a;
+  rate->den = 1000 / a;
+  return true;
+}
+
+uint16_t TrackDirectory::lowerBound(uint32_t key) const {
+  uint16_t lo = 0, hi = _n;
+  while (lo < hi) {
+    uint16_t mid = (lo + hi) / 2;
+    if (_entries[mid] < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+bool TrackDirectory::parse(const char *name, uint32_t *entry) {
+  // "NNN-FF.ogg", "NNN-FF-L.ogg", "NNN-FF.fff.ogg" or "NNN-FF.fff-L.ogg"
+  size_t len = strlen(name);
+  if (len < 10 || strcasecmp(&name[len - 4], ".ogg"))
+    return false;
+  len -= 4;
+  bool loop = name[len - 2] == '-' && toupper(name[len - 1]) == 'L';
+  if (loop)
+    len -= 2;
+  for (uint8_t i : {0, 1, 2})
+    if (name[i] < '0' || name[i] > '9')
+      return false;
+  uint16_t milli;
+  uint8_t  decimals;
+  if (name[3] != '-' || !parseFps(&name[4], len - 4, &milli, &decimals))
+    return false;
+  uint16_t track = (name[0] - '0') * 100 + (name[1] - '0') * 10 + (name[2] - '0');
+  *entry = (uint32_t) track << 20 | (uint32_t) loop << 19 | (uint32_t) milli << 2 | decimals;
+  return true;
+}
+
+bool TrackDirectory::parseFps(const char *text, size_t len, uint16_t *milli, uint8_t *decimals) {
+  // "FF" or "FF.f" to "FF.fff", 12 to 25 fps
+  if (len < 2 || len == 3 || len > 6 || (len > 3 && text[2] != '.'))
+    return false;
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < len; i++) {
+    if (i == 2)
+      continue;
+    if (text[i] < '0' || text[i] > '9')
+      return false;
+    value = value * 10 + text[i] - '0';
+  }
+  *decimals = (len > 3) ? len - 3 : 0;
+  for (uint8_t i = *decimals; i < 3; i++)
+    value *= 10;
+  if (value < 12000 || value > 25000)
+    return false;
+  *milli = value;
+  return true;
+}
@@ -0,0 +1,178 @@
+#!/usr/bin/env python3
+"""Session logs of SynkinoLC (firmware built with -D SESSION_LOG) to CSV and plots.
+
+The firmware writes a log next to the track for every playback session, e.g.,
+"001-24.log" for "001-24.ogg" (see include/sessionlog.h for the format). Copy
+it off the SD card (MTP or card reader) and run
+
+    tools/synclog.py 001-24.log              # summary, CSV to 001-24.csv
+    tools/synclog.py 001-24.log --plot       # ... and plots (needs matplotlib)
+    tools/synclog.py 001-24.log --plot x.png # ... saved to a file instead
+
+A log that wasn't closed (power cut during the show) is read up to its last
+sync, at most LOG_SYNC_SECTORS sectors (~100 s) short of the end.
+"""
+
+import argparse
+import csv
+import math
+import struct
+import sys
+
+SECTOR = 512
+HEADER = struct.Struct("<8sBBHHHHBBBBB13sIIIIIBBB")
+RECORD = struct.Struct("<IIIiffhHBBBB")
+HEADER_FIELDS = ("magic", "version", "recordSize", "track", "fs", "fpsNum", "fpsDen",
+                 "blades", "filter", "p", "i", "d", "projector", "tickMicros",
+                 "startFrame", "decoderLatency", "records", "dropped",
+                 "pFrac", "iFrac", "dFrac")
+RECORD_FIELDS = ("micros", "impulses", "samples", "delta", "input", "output",
+                 "syncOffset", "underflows", "readAhead", "stream", "audio", "flags")
+LOG_RAMP = 0x01
+LOG_TUNE = 0x02
+PPM2 = 524288                         # playback rate adjustment of 100 %
+
+
+def read_log(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) < SECTOR:
+        sys.exit(f"{path}: too short for a session log")
+    header = dict(zip(HEADER_FIELDS, HEADER.unpack_from(data)))
+    if header["magic"].rstrip(b"\0") != b"SYNKLOG":
+        sys.exit(f"{path}: not a session log")
+    if header["version"] != 1 or header["recordSize"] != RECORD.size:
+        sys.exit(f"{path}: unknown format (version {header['version']})")
+    header["projector"] = header["projector"].split(b"\0")[0].decode(errors="replace")
+
+    records = []
+    for offset in range(SECTOR, len(data) - RECORD.size + 1, RECORD.size):
+        chunk = data[offset:offset + RECORD.size]
+        if not any(chunk):            # padding of the last sector
+            break
+        records.append(dict(zip(RECORD_FIELDS, RECORD.unpack(chunk))))
+    if header["records"]:
+        records = records[:header["records"]]
+    return header, records
+
+
+def convert(header, records):
+    """Adds time [s] from the first tick and sync errors in frames."""
+    fps = header["fpsNum"] / header["fpsDen"]
+    frames_per_sample = fps / header["fs"]
+    elapsed, previous = 0, None
+    for r in records:
+        if previous is not None:
+            elapsed += (r["micros"] - previous) & 0xFFFFFFFF   # micros() wraps after 71 min
+        previous = r["micros"]
+        r["time"] = elapsed / 1E6
+        r["frame"] = r["impulses"] / header["blades"]
+        r["deltaFrames"] = r["delta"] * frames_per_sample
+        r["inputFrames"] = r["input"] * frames_per_sample
+        r["outputPercent"] = r["output"] / PPM2 * 100
+        r["syncOffsetFrames"] = r["syncOffset"] / header["blades"]
+        r["ramp"] = int(bool(r["flags"] & LOG_RAMP))
+        r["tune"] = int(bool(r["flags"] & LOG_TUNE))
+    return records
+
+
+def gains(h):
+    return "/".join(f"{h[k]}.{h[k + 'Frac']:02d}" for k in "pid")
+
+
+def summary(path, header, records):
+    fps = header["fpsNum"] / header["fpsDen"]
+    print(f"{path}: track {header['track']:03d}, {fps:.3f} fps, {header['fs']} Hz, "
+          f"{header['blades']} blades, projector \"{header['projector']}\"")
+    print(f"  PID {gains(header)}, "
+          f"{'tracker' if header['filter'] else 'moving average'}, "
+          f"tick {header['tickMicros'] / 1000:.0f} ms, start frame {header['startFrame']}, "
+          f"decoder latency {header['decoderLatency']} us")
+    if not header["records"]:
+        print("  log wasn't closed: read up to its last sync")
+    if not records:
+        print("  no records")
+        return
+    tick = header["tickMicros"] / 1E6
+    gaps = sum(1 for a, b in zip(records, records[1:]) if b["time"] - a["time"] > 1.5 * tick)
+    errors = [r["inputFrames"] for r in records]
+    rms = math.sqrt(sum(e * e for e in errors) / len(errors))
+    worst = max(records, key=lambda r: abs(r["inputFrames"]))
+    underflows = (records[-1]["underflows"] - records[0]["underflows"]) & 0xFFFF
+    print(f"  {len(records)} ticks over {records[-1]['time']:.0f} s, "
+          f"{header['dropped']} dropped, {gaps} gaps")
+    print(f"  sync error: rms {rms:.2f} frames, max {worst['inputFrames']:+.2f} frames "
+          f"at {worst['time']:.1f} s")
+    tuning = sum(r["tune"] for r in records)
+    if tuning:
+        print(f"  auto-tuning the first {tuning * tick:.0f} s")
+    print(f"  ramping {sum(r['ramp'] for r in records) * tick:.0f} s, "
+          f"underflows {underflows}, lowest stream buffer {min(r['stream'] for r in records)} %")
+
+
+def write_csv(path, records):
+    columns = ("time", "micros", "impulses", "frame", "samples", "delta", "deltaFrames",
+               "input", "inputFrames", "output", "outputPercent", "syncOffsetFrames",
+               "underflows", "readAhead", "stream", "audio", "ramp", "tune")
+    with open(path, "w", newline="") as f:
+        w = csv.writer(f)
+        w.writerow(columns)
+        for r in records:
+            w.writerow([f"{r[c]:.4f}" if isinstance(r[c], float) else r[c] for c in columns])
+
+
+def plot(header, records, path):
+    try:
+        import matplotlib
+    except ImportError:
+        sys.exit("plots need matplotlib (pip install matplotlib)")
+    if path:
+        matplotlib.use("Agg")
+    import matplotlib.pyplot as plt
+    t = [r["time"] for r in records]
+    fig, ax = plt.subplots(3, 1, sharex=True, figsize=(12, 8))
+    ax[0].plot(t, [r["deltaFrames"] for r in records], lw=0.5, label="raw")
+    ax[0].plot(t, [r["inputFrames"] for r in records], lw=1, label="filtered")
+    ax[0].set_ylabel("audio ahead [frames]")
+    ax[0].legend(loc="upper right")
+    ax[1].plot(t, [r["outputPercent"] for r in records], lw=1)
+    ramps = [r["time"] for r in records if r["ramp"]]
+    if ramps:
+        ax[1].plot(ramps, [0] * len(ramps), "|", color="red", label="ramp")
+        ax[1].legend(loc="upper right")
+    ax[1].set_ylabel("PID output [%]")
+    for key in ("readAhead", "stream", "audio"):
+        ax[2].plot(t, [r[key] for r in records], lw=1, label=key)
+    ax[2].set_ylabel("buffer fill [%]")
+    ax[2].set_xlabel("time [s]")
+    ax[2].legend(loc="lower right")
+    fps = header["fpsNum"] / header["fpsDen"]
+    fig.suptitle(f"Track {header['track']:03d}, {fps:.3f} fps, {header['fs']} Hz, "
+                 f"{header['projector']}")
+    fig.tight_layout()
+    if path:
+        fig.savefig(path, dpi=120)
+    else:
+        plt.show()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log", help="session log from the SD card")
+    parser.add_argument("-o", "--csv", help="CSV file (default: log with .csv)")
+    parser.add_argument("--plot", nargs="?", const="", metavar="FILE",
+                        help="plot sync error, PID output and buffers (to FILE)")
+    args = parser.parse_args()
+
+    header, records = read_log(args.log)
+    records = convert(header, records)
+    summary(args.log, header, records)
+    csv_path = args.csv or args.log.rsplit(".", 1)[0] + ".csv"
+    write_csv(csv_path, records)
+    print(f"  -> {csv_path}")
+    if args.plot is not None and records:
+        plot(header, records, args.plot)
+
+
+if __name__ == "__main__":
+    main()
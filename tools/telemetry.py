@@ -0,0 +1,226 @@
+#!/usr/bin/env python3
+"""Live telemetry of SynkinoLC (firmware built with -D TELEMETRY).
+
+Decodes the frames sent on the serial port during playback (see
+include/telemetry.h) and plots frame offset, PID terms and buffer levels as
+they come in. Debug output on the same port is passed through as text.
+
+    tools/telemetry.py /dev/ttyUSB0                 # live plot (pyserial, matplotlib)
+    tools/telemetry.py /dev/ttyUSB0 --csv show.csv  # ... and record the ticks
+    tools/telemetry.py capture.bin --no-plot        # decode a capture, e.g., from the bench (-e)
+"""
+
+import argparse
+import collections
+import csv
+import os
+import re
+import struct
+import sys
+import time
+
+SESSION, TICK = 1, 2
+SESSION_RECORD = struct.Struct("<HHHHBBBBBIBBB")
+SESSION_FIELDS = ("track", "fs", "fpsNum", "fpsDen", "blades", "filter", "p", "i", "d",
+                  "startFrame", "pFrac", "iFrac", "dFrac")
+TICK_RECORD = struct.Struct("<IIifffffffHBBBB")
+TICK_FIELDS = ("micros", "impulses", "delta", "input", "frames", "pTerm", "iTerm", "dTerm",
+               "output", "feedForward", "sciMicros", "readAhead", "stream", "audio", "flags")
+RAMP = 0x01
+TUNE = 0x02
+PPM2 = 524288 / 100                   # ppm2 per percent of playback speed
+PRINTABLE = re.compile(rb"[\x20-\x7e\t\r\n]*")
+TEXT = re.compile(rb"[\x20-\x7e\t\r\n]{6,}")   # debug output amid a garbled frame
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE, as Telemetry::crc16()."""
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+        crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+class Decoder:
+    """Splits the byte stream at zero bytes and sorts out frames and text."""
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.seq = None
+        self.frames = self.lost = self.corrupt = 0
+        self.session = None
+
+    def feed(self, data):
+        self.buffer += data
+        *chunks, self.buffer = self.buffer.split(b"\0")
+        for chunk in chunks:
+            yield from self.chunk(bytes(chunk))
+
+    def chunk(self, chunk):
+        frame = cobs_decode(chunk) if chunk else None
+        if frame and len(frame) >= 4 and crc16(frame[:-2]) == frame[-2] | frame[-1] << 8:
+            type_, seq, record = frame[0], frame[1], frame[2:-2]
+            if self.seq is not None:
+                self.lost += (seq - self.seq - 1) & 0xFF
+            self.seq = seq
+            self.frames += 1
+            if type_ == SESSION and len(record) == SESSION_RECORD.size:
+                self.session = dict(zip(SESSION_FIELDS, SESSION_RECORD.unpack(record)))
+                yield "session", self.session
+            elif type_ == TICK and len(record) == TICK_RECORD.size:
+                yield "tick", dict(zip(TICK_FIELDS, TICK_RECORD.unpack(record)))
+            return
+        # anything else is debug output - or a frame garbled by it
+        if chunk and not PRINTABLE.fullmatch(chunk):
+            self.corrupt += 1
+        for text in TEXT.findall(chunk) if chunk else ():
+            yield "text", text.decode("ascii")
+
+
+def source(path, baud):
+    """Chunks of bytes from a serial port or a file ('-': stdin)."""
+    if path == "-":
+        while data := sys.stdin.buffer.read1(4096):
+            yield data
+    elif os.path.isfile(path):
+        with open(path, "rb") as f:
+            while data := f.read(4096):
+                yield data
+    else:
+        try:
+            import serial
+        except ImportError:
+            sys.exit("reading from a serial port needs pyserial (pip install pyserial)")
+        with serial.Serial(path, baud, timeout=0.05) as port:
+            while True:
+                yield port.read(max(1, port.in_waiting))
+
+
+class Plot:
+    """Frame offset, PID terms and buffer levels over the last few seconds."""
+
+    def __init__(self, window):
+        try:
+            import matplotlib.pyplot as plt
+        except ImportError:
+            sys.exit("plots need matplotlib (pip install matplotlib), or use --no-plot")
+        self.plt = plt
+        self.window = window
+        self.t0 = None
+        self.data = collections.defaultdict(lambda: collections.deque())
+        plt.ion()
+        self.fig, self.ax = plt.subplots(3, 1, sharex=True, figsize=(12, 8))
+        self.lines = {}
+        for ax, keys, label in ((self.ax[0], ("frames",), "audio ahead [frames]"),
+                                (self.ax[1], ("pTerm", "iTerm", "dTerm", "output", "feedForward"),
+                                 "playback speed [%]"),
+                                (self.ax[2], ("readAhead", "stream", "audio"), "buffer fill [%]")):
+            for key in keys:
+                self.lines[key], = ax.plot([], [], lw=1, label=key)
+            ax.set_ylabel(label)
+            ax.legend(loc="upper left", fontsize="small")
+        self.ax[2].set_xlabel("time [s]")
+        self.last_draw = 0
+
+    def add(self, tick):
+        if self.t0 is None:
+            self.t0 = tick["micros"]
+        t = ((tick["micros"] - self.t0) & 0xFFFFFFFF) / 1E6
+        self.data["t"].append(t)
+        for key in self.lines:
+            value = tick[key]
+            if key in ("pTerm", "iTerm", "dTerm", "output", "feedForward"):
+                value /= PPM2
+            self.data[key].append(value)
+        while self.data["t"][0] < t - self.window:
+            for series in self.data.values():
+                series.popleft()
+
+    def draw(self, force=False):
+        if not self.data["t"] or (not force and time.monotonic() - self.last_draw < 0.2):
+            return
+        self.last_draw = time.monotonic()
+        for key, line in self.lines.items():
+            line.set_data(self.data["t"], self.data[key])
+        for ax in self.ax:
+            ax.relim()
+            ax.autoscale_view()
+        self.fig.canvas.draw_idle()
+        self.plt.pause(0.001)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("source", help="serial port, capture file or '-' for stdin")
+    parser.add_argument("-b", "--baud", type=int, default=31250)
+    parser.add_argument("--csv", help="record ticks to a CSV file")
+    parser.add_argument("--window", type=float, default=60, help="plotted time span [s]")
+    parser.add_argument("--no-plot", action="store_true", help="print ticks instead")
+    args = parser.parse_args()
+
+    decoder = Decoder()
+    plot = None if args.no_plot else Plot(args.window)
+    out = writer = None
+    if args.csv:
+        out = open(args.csv, "w", newline="")
+        writer = csv.writer(out)
+        writer.writerow(TICK_FIELDS)
+    ticks = 0
+    try:
+        for data in source(args.source, args.baud):
+            for kind, item in decoder.feed(data):
+                if kind == "text":
+                    for line in item.splitlines():
+                        if line.strip():
+                            print(f"> {line}")
+                elif kind == "session":
+                    s = item
+                    print(f"session: track {s['track']:03d}, {s['fpsNum'] / s['fpsDen']:.3f} fps, "
+                          f"{s['fs']} Hz, {s['blades']} blades, PID "
+                          + "/".join(f"{s[k]}.{s[k + 'Frac']:02d}" for k in "pid"))
+                else:
+                    ticks += 1
+                    if writer:
+                        writer.writerow(item[key] for key in TICK_FIELDS)
+                    if plot:
+                        plot.add(item)
+                    elif ticks % 10 == 0:
+                        print(f"{item['micros'] / 1E6:9.1f} s  {item['frames']:+6.2f} fr  "
+                              f"P {item['pTerm'] / PPM2:+6.2f} I {item['iTerm'] / PPM2:+6.2f} "
+                              f"D {item['dTerm'] / PPM2:+6.2f} ff {item['feedForward'] / PPM2:+6.2f} %  "
+                              f"buffers {item['readAhead']:3d} {item['stream']:3d} {item['audio']:3d} %"
+                              f"{'  ramp' if item['flags'] & RAMP else ''}"
+                              f"{'  tune' if item['flags'] & TUNE else ''}")
+            if plot:
+                plot.draw()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if out:
+            out.close()
+    print(f"{decoder.frames} frames, {ticks} ticks, {decoder.lost} lost, {decoder.corrupt} corrupt")
+    if plot:
+        plot.draw(force=True)
+        plot.plt.ioff()
+        plot.plt.show()
+
+
+if __name__ == "__main__":
+    main()